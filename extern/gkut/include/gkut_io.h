@@ -48,4 +48,17 @@ void ndx_filter_traj(const char *ndx_fname, rvec **pre_x, rvec ***new_x, int nfr
  * 2D memory is allocated for new_x.
  */
 
+void filter_traj_groups(int numgroups, atom_id **indx, int *isize, rvec **pre_x, rvec ***new_x, int nframes);
+/* Creates a new trajectory with only the coordinates from pre_x that are specified by the indexes of numgroups groups in indx.
+ * Each frame of new_x holds the coordinates of every group, one group after another.
+ * 2D memory is allocated for new_x.
+ */
+
+void ndx_filter_traj_groups(const char *ndx_fname, int numgroups, rvec **pre_x, rvec ***new_x, int nframes, int **natoms);
+/* Like ndx_filter_traj, but selects numgroups groups from the index file.
+ * Each frame of new_x holds the coordinates of every group, one group after another in the order they were selected.
+ * The number of atoms in each group is put in 1D array *natoms.
+ * 2D memory is allocated for new_x and 1D memory is allocated for natoms.
+ */
+
 #endif // GKUT_IO_H
\ No newline at end of file
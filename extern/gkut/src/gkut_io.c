@@ -78,20 +78,41 @@ void filter_vecs(atom_id *indx, int isize, rvec *pre_x, rvec **new_x) {
 }
 
 void ndx_filter_traj(const char *ndx_fname, rvec **pre_x, rvec ***new_x, int nframes, int *natoms) {
-	const int NUMGROUPS = 1;
 	int *isize;
-	atom_id **indx;
 
-	ndx_get_indx(ndx_fname, NUMGROUPS, &indx, &isize);
+	ndx_filter_traj_groups(ndx_fname, 1, pre_x, new_x, nframes, &isize);
 
 	*natoms = isize[0];
 	sfree(isize);
+}
+
+void filter_traj_groups(int numgroups, atom_id **indx, int *isize, rvec **pre_x, rvec ***new_x, int nframes) {
+	int tot_atoms = 0;
+
+	for(int g = 0; g < numgroups; ++g) {
+		tot_atoms += isize[g];
+	}
 
 	snew(*new_x, nframes);
 	for(int i = 0; i < nframes; ++i) {
-		filter_vecs(indx[0], *natoms, pre_x[i], &((*new_x)[i]));
+		snew((*new_x)[i], tot_atoms);
+		for(int g = 0, n = 0; g < numgroups; n += isize[g++]) {
+			for(int j = 0; j < isize[g]; ++j) {
+				copy_rvec(pre_x[i][indx[g][j]], (*new_x)[i][n + j]);
+			}
+		}
 	}
+}
+
+void ndx_filter_traj_groups(const char *ndx_fname, int numgroups, rvec **pre_x, rvec ***new_x, int nframes, int **natoms) {
+	atom_id **indx;
 
-	sfree(indx[0]);
+	ndx_get_indx(ndx_fname, numgroups, &indx, natoms);
+
+	filter_traj_groups(numgroups, indx, *natoms, pre_x, new_x, nframes);
+
+	for(int g = 0; g < numgroups; ++g) {
+		sfree(indx[g]);
+	}
 	sfree(indx);
 }
@@ -51,13 +51,14 @@ void print_log(char const *fmt, ...) {
 
 void log_fatal(int fatal_errno, const char *file, int line, char const *fmt, ...) {
 	va_list arg;
-	if(out_log != NULL) {
-		va_start(arg, fmt);
-		fprintf(out_log, "Fatal error in source file %s line %d: ", file, line);
-		vfprintf(out_log, fmt, arg);
-		va_end(arg);
-	}
+	char msg[4096];
+
 	va_start(arg, fmt);
-	gmx_fatal(fatal_errno, file, line, fmt, arg);
+	vsnprintf(msg, sizeof(msg), fmt, arg);
 	va_end(arg);
+	if(out_log != NULL) {
+		fprintf(out_log, "Fatal error in source file %s line %d: %s", file, line, msg);
+	}
+	// gmx_fatal is variadic and cannot be given the va_list
+	gmx_fatal(fatal_errno, file, line, "%s", msg);
 }
@@ -19,10 +19,16 @@
  * Routines for Arbitrary Precision Floating-point Arithmetic and Fast Robust Geometric Predicates.
  */
 
+#ifndef DELAUNAY_TRI_H
+#define DELAUNAY_TRI_H
+
+#include <stdint.h>
 #include "predicates.h"
 
 typedef REAL dtreal;
 
+#define MINPOINTS 2 // Fewest points that can be triangulated
+
 
 struct dTriangulation {
     dtreal *points; // coordinates of input points (2 ordered reals, x and y, per point)
@@ -34,6 +40,19 @@ struct dTriangulation {
     int nverts; // equivalent to the number of non-duplicate input points
 };
 
+/* Point locator of a triangulation: a grid of buckets over the points, 
+ * each holding a triangle near it from which to walk to the triangle containing a query point.
+ */
+struct dtLocator {
+    dtreal *points; // copy of the coordinates of the triangulated points (2 per point)
+    int *triangles; // copy of the triangles, with vertices in counterclockwise order
+    int *neighbours; // triangle across the edge from vertex j to vertex j+1 of each triangle, indexed by [triangle # * 3 + j]. -1 on the convex hull.
+    int ntriangles;
+    dtreal xmin, ymin, cell; // origin and width of the bucket grid
+    int nx, ny; // number of buckets along x and y
+    int *buckets; // triangle from which to start walking for each bucket, indexed by [x bucket * ny + y bucket]
+};
+
 
 void dtinit();
 /* Call this once before calling dtriangulate()
@@ -44,3 +63,52 @@ void dtriangulate(struct dTriangulation *tri);
  * storing the resulting triangles in tri (see struct above).
  * Memory is allocated for tri->triangles.
  */
+
+int dtedges(const struct dTriangulation *tri, uint64_t **edges);
+/* Finds the unique edges of the triangles in tri, stored in *edges as sorted 64-bit keys 
+ * (see dtedge_key below), and returns the number of edges.
+ * Memory is allocated for *edges. free() it when done.
+ */
+
+void dtlocinit(struct dtLocator *loc, const dtreal *points, const struct dTriangulation *tri);
+/* Builds a point locator for the triangles in tri of the given points (2 ordered reals, x and y, per point),
+ * which can be tri->points. The points and triangles are copied, so tri can be freed afterwards.
+ * Memory is allocated in loc. Call dtlocfree when done.
+ */
+
+int dtlocate(const struct dtLocator *loc, dtreal x, dtreal y, int hint, dtreal *bary);
+/* Returns the index of the triangle of loc containing the point (x, y), or -1 if the point is outside of the triangulation.
+ * The walk to the triangle starts from hint if it is >= 0, otherwise from the bucket of the point,
+ * so it takes O(1) expected time. If bary is not NULL and the point was found, its barycentric coordinates
+ * with respect to the vertices loc->triangles[3*t], [3*t+1] and [3*t+2] of the triangle t are stored in bary[0..2].
+ */
+
+void dtlocateall(const struct dtLocator *loc, const dtreal *q, int nq, int *tris, dtreal *bary);
+/* Locates nq query points q (2 ordered reals, x and y, per point) as dtlocate, storing the triangle of each in tris 
+ * and their barycentric coordinates in bary (3 per point, can be NULL). 
+ * The walk for each point starts from the triangle of the previous one if they are in the same bucket.
+ */
+
+void dtlocfree(struct dtLocator *loc);
+/* Frees the dynamic memory in a point locator.
+ */
+
+
+/* Key of the edge between points a and b, which is the same for (a, b) and (b, a).
+ * The smaller index is in the high 32 bits, so sorted keys are ordered by their first point.
+ */
+static inline uint64_t dtedge_key(int a, int b) {
+    return a < b ? ((uint64_t)a << 32) | (uint32_t)b : ((uint64_t)b << 32) | (uint32_t)a;
+}
+
+/* The smaller and larger point index of an edge key.
+ */
+static inline int dtedge_a(uint64_t key) {
+    return (int)(key >> 32);
+}
+
+static inline int dtedge_b(uint64_t key) {
+    return (int)(key & 0xffffffff);
+}
+
+#endif // DELAUNAY_TRI_H
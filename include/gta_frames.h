@@ -0,0 +1,229 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ *
+ * This program uses the GROMACS molecular simulation package API.
+ * Copyright (c) 1991-2000, University of Groningen, The Netherlands.
+ * Copyright (c) 2001-2004, The GROMACS development team.
+ * Copyright (c) 2013,2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed at http://www.gromacs.org.
+ */
+
+#ifndef GTA_FRAMES_H
+#define GTA_FRAMES_H
+
+#include <math.h>
+#include <stddef.h>
+#include "vec.h"
+#include "gta_xtc.h"
+#ifdef GRO_V5
+#include "pargs.h"
+#else
+#include "statutil.h"
+#endif
+
+#define FRAMES_ALIGN 64 // Alignment in bytes of every coordinate plane, a cache line
+
+struct frames_source; // Trajectory file whose frames are decoded as they are needed (see read_frames_lazy)
+
+/* Trajectory frames held in one large aligned block of memory.
+ * Each frame is stored as three planes of coordinates, all of the x coordinates, then all of the y and then all of the z,
+ * each padded to a multiple of FRAMES_ALIGN bytes, and the frames follow each other in order.
+ * Where available, the block is backed by transparent huge pages.
+ */
+struct gta_frames {
+    real *data; // [nframes][3][stride]
+    matrix *box; // Box of each frame
+    real *time; // Time of each frame (ps)
+    int nframes, natoms;
+    size_t stride; // Number of reals in each plane, natoms rounded up so that planes stay aligned
+    int capacity; // Number of frames that fit in data before it is reallocated
+    void *map; // Raw trajectory file mapped into memory, if data points into it (read only), or NULL
+    size_t map_size;
+    struct frames_source *source; // Where the coordinates of frames are decoded from by frames_load, or NULL if every frame is decoded
+};
+
+/* Raw trajectory file, a copy of the selected atoms of a trajectory laid out like a frame store of floats,
+ * so that it can be mapped into memory and used without reading or decoding. 
+ * All values are in the byte order of the machine that wrote the file.
+ *
+ * Header:  char magic[8] = "GTARAW1", int64 source_size, int64 source_mtime_sec, int64 source_mtime_nsec, 
+ *          int32 source_natoms, int32 natoms, int32 nframes, int32 stride, int64 data_offset, 
+ *          float32 begin, float32 end, float32 dt, int32 skip (the frame_range the frames were read with), 
+ *          int32 atoms[natoms] (index of each atom in the source trajectory), 
+ *          float32 times[nframes], float32 boxes[nframes][3][3]
+ * Frames:  float32 [nframes][3][stride] at data_offset, a multiple of the page size.
+ *          Each plane has the x, y or z coordinates of the natoms atoms, padded to stride.
+ *
+ * source_size and source_mtime are the size and modification time of the trajectory the file was made from.
+ */
+
+/* Selection of the frames of a trajectory to read, by time and then by stride.
+ */
+struct frame_range {
+    real begin, end; // Times of the first and last frames to read (ps). Negative for the first and last frames of the trajectory
+    real dt; // Only read frames at multiples of dt (ps) after the first frame of the trajectory. 0 for every frame
+    int stride; // Of the frames within the times above, only read every stride-th one
+};
+
+static inline int frame_in_time(const struct frame_range *range, real t, real t0) {
+    if(range == NULL)   return 1;
+    if(range->begin >= 0 && t < range->begin)   return 0;
+    if(range->end >= 0 && t > range->end)   return 0;
+    if(range->dt > 0) {
+        double q = (t - t0) / range->dt;
+        if(fabs(q - floor(q + 0.5)) > 1e-3)     return 0;
+    }
+    return 1;
+}
+/* Whether the frame at time t of a trajectory whose first frame is at time t0 is within the times of range.
+ * A NULL range selects every frame.
+ */
+
+void frames_init(struct gta_frames *frames, int natoms, int capacity);
+/* Initializes an empty frame store for frames of natoms atoms, with room for capacity frames.
+ * Memory is allocated for the frames. Call frames_free when done.
+ */
+
+void frames_append(struct gta_frames *frames, const rvec *x, const atom_id *indx, matrix box, real t);
+/* Adds a frame to the end of the store, growing it if full.
+ * The coordinates are x[indx[i]] for each of the natoms atoms of the store, or x[i] if indx is NULL.
+ */
+
+void frames_get(const struct gta_frames *frames, int fr, rvec *x);
+/* Copies the coordinates of frame fr into x, which must have room for natoms vectors.
+ */
+
+static inline const real *frames_x(const struct gta_frames *frames, int fr) {
+    return frames->data + 3 * fr * frames->stride;
+}
+
+static inline const real *frames_y(const struct gta_frames *frames, int fr) {
+    return frames->data + (3 * fr + 1) * frames->stride;
+}
+
+static inline const real *frames_z(const struct gta_frames *frames, int fr) {
+    return frames->data + (3 * fr + 2) * frames->stride;
+}
+/* The aligned x, y and z coordinate planes of frame fr.
+ */
+
+void read_frames(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, const struct frame_range *range,
+    const char *raw_fname, struct gta_frames *frames, int *natoms, output_env_t *oenv);
+/* Reads a trajectory file into frames, keeping only the atoms given by the indexes of numgroups groups in indx,
+ * one group after another, as each frame is read. If indx is NULL, every atom is kept.
+ * Only the frames in range are kept, or all if range is NULL.
+ * XTC files are read with the reader of gta_xtc.h: their frames are found first and then decoded by all of the 
+ * OpenMP threads at once, each a range of frames. The frames are found once and then cached next to the file 
+ * (see xtc_cached_index), so frames out of range are never decompressed. 
+ * Other formats are read one frame at a time by GROMACS, which decodes every frame up to the end of the range.
+ * Without GROMACS (see lite/), TRR files are read this way by the reader of gta_trr.h, and other formats cannot be read.
+ * If raw_fname is not NULL and is a raw trajectory file made from traj_fname (unchanged since, or no longer present) 
+ * holding every selected atom, and either made with the same range or with every frame, the frames are taken from it instead. 
+ * If it also holds exactly the selected atoms in the frames of range, the file is mapped into memory and used as the 
+ * frame store without copying (in single precision). Otherwise the trajectory is read and the frames are saved to raw_fname.
+ * *natoms is set to the number of atoms in the trajectory file.
+ * output_env_t *oenv is needed for reading trajectory files.
+ * Memory is allocated for the frames. Call frames_free when done.
+ */
+
+void read_frames_lazy(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, const struct frame_range *range,
+    const char *raw_fname, struct gta_frames *frames, int *natoms, output_env_t *oenv);
+/* Like read_frames, but the frames of an XTC file are only found, with their times and boxes, and their coordinates 
+ * are not decoded until frames_load is called for them, so that frames an analysis does not reach are never decoded. 
+ * Room is allocated for the coordinates of every frame, but the memory of frames that are never decoded is never touched. 
+ * Other formats, and any trajectory if raw_fname is not NULL, are read by read_frames.
+ */
+
+void frames_load(const struct gta_frames *frames, const int *frs, int n);
+/* Decodes those of the n frames frs of frames that have not been decoded yet, with all of the OpenMP threads like read_frames.
+ * Does nothing if every frame of frames is decoded, ie unless it was read by read_frames_lazy.
+ * Must not run while the coordinates of frames are being used.
+ */
+
+void frames_free(struct gta_frames *frames);
+
+
+#define PACK_BLOCK 16 // Number of frames in each block of a packed frame store
+
+/* Trajectory frames held in memory in compressed form, for analyses that pass over every frame in turn.
+ * Coordinates are rounded to integers in units of 1/precision nm, as in XTC files, and the frames are grouped into 
+ * blocks of PACK_BLOCK frames. The first frame of a block is kept as 32-bit integers and every other frame as 
+ * its differences from the frame before, in 8, 16 or 32 bits, the fewest that hold every difference in the block.
+ * The integers are laid out in planes like gta_frames, so a block is decoded by running sums over contiguous arrays, 
+ * which the compiler vectorizes.
+ */
+struct packed_block {
+    int first, nframes; // First frame in the block and number of frames in it
+    int width; // Size in bytes of each difference: 1, 2 or 4
+    char *data; // int32 [3][stride] of the first frame, then the differences [nframes - 1][3][stride]
+};
+
+struct gta_packed_frames {
+    struct packed_block *blocks;
+    matrix *box; // Box of each frame
+    real *time; // Time of each frame (ps)
+    int nblocks, nframes, natoms;
+    size_t stride; // Number of integers in each plane, as in gta_frames
+    real precision; // Integer units per nm
+    size_t size; // Total size of the blocks in bytes
+};
+
+void packed_init(struct gta_packed_frames *packed, real precision);
+/* Initializes an empty packed frame store with the given precision (1000 keeps 3 decimals, like XTC files).
+ */
+
+void packed_add(struct gta_packed_frames *packed, const struct gta_frames *frames);
+/* Compresses the frames of frames and adds them to the end of packed. 
+ * Every call must pass frames of the same atoms.
+ */
+
+void packed_decode(const struct gta_packed_frames *packed, int block, struct gta_frames *frames);
+/* Decodes the frames of block into frames, replacing the frames it held. 
+ * frames must have been initialized for packed->natoms atoms and room for PACK_BLOCK frames.
+ */
+
+void read_packed_frames(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, const struct frame_range *range,
+    const char *raw_fname, real precision, struct gta_packed_frames *packed, int *natoms, output_env_t *oenv);
+/* Reads a trajectory file into packed like read_frames, compressing the frames a few at a time as they are read, 
+ * so that the whole trajectory is never held uncompressed (unless it is first read for raw_fname).
+ * Memory is allocated for the frames. Call packed_free when done.
+ */
+
+void packed_free(struct gta_packed_frames *packed);
+
+
+/* Reader of an XTC file that is still being written, eg by a running simulation.
+ * At the end of the file, or of a frame that has only been written in part, it waits for more frames to be appended.
+ */
+struct frames_follower {
+    FILE *f;
+    char *fname;
+    struct xtc_decoder dec;
+    float *x; // Coordinates of the frame being read
+    rvec *xr; // The same in reals
+    atom_id *sel; // Indexes of the selected atoms, or NULL for all
+    int natoms, nsel; // Number of atoms in the file and selected
+    int64_t offset; // Byte offset of the next frame in the file
+    int nframes; // Number of frames read so far
+};
+
+int follow_open(struct frames_follower *fl, const char *traj_fname, int numgroups, atom_id **indx, const int *isize, 
+                real wait, int *natoms);
+/* Opens the XTC file traj_fname to follow, keeping only the atoms given by the indexes of numgroups groups in indx 
+ * like read_frames (or all if indx is NULL), and waits up to wait seconds in all for the file to be created and for its first frame.
+ * *natoms is set to the number of atoms in the file. Returns 0 if a frame was found and -1 otherwise.
+ * Exits with an error if the first frame is corrupt, rather than still being written.
+ * Call follow_close when done, even if no frame was found.
+ */
+
+int follow_read(struct frames_follower *fl, struct gta_frames *frames, int max_frames, real wait);
+/* Replaces the frames in frames with the next frames of the file, at most max_frames of them, 
+ * waiting up to wait seconds for the first one if there is none yet. Frames that are already complete are read 
+ * without waiting. frames must have been initialized for fl->nsel atoms. Returns the number of frames read.
+ * Exits with an error at a corrupt frame, ie one that cannot be decoded although all of its bytes have been written.
+ */
+
+void follow_close(struct frames_follower *fl);
+
+#endif // GTA_FRAMES_H
@@ -13,6 +13,7 @@
 #define GTA_GRID_H
 
 #include "vec.h"
+#include "gta_frames.h"
 #ifdef GRO_V5
 #include "pargs.h"
 #else
@@ -49,16 +50,20 @@ real weight_dist2(rvec traj_point, rvec grid_point);
 /***/
 
 
-void gta_grid_area(const char *traj_fname, const char *ndx_fname, 
-    real cell_width, real (*fweight)(rvec, rvec), output_env_t *oenv, struct tessellated_grid *grid);
+void gta_grid_area(const char *traj_fname, const char *ndx_fname, const struct frame_range *range, const char *raw_fname, 
+    real precision, real cell_width, real (*fweight)(rvec, rvec), output_env_t *oenv, struct tessellated_grid *grid);
 /* Reads a trajectory file and then calculates approximate surface area (see the f_gta_grid_area function below).
  * If ndx_fname is not null, only a selection within the trajectory will be included in the grid.
+ * Only the frames in range are included, or all if range is NULL (see gta_frames.h).
+ * If raw_fname is not NULL, the selected atoms are read from or saved to this raw trajectory file (see read_frames).
+ * If precision is greater than 0, the frames are kept compressed in memory with this precision (see read_packed_frames) 
+ * and decompressed a block at a time as the grid is built, which takes a fraction of the memory of the plain frames.
  * output_env_t *oenv is needed for reading trajectory files.
- * You can initialize one using output_env_init() in Gromacs's oenv.h.
+ * You can initialize one using output_env_init() in Gromacs's oenv.h. Without Gromacs (see lite/) it is not used and can be NULL.
  * Memory is allocated for arrays in grid. Call free_grid when done.
  */
 
-void f_gta_grid_area(rvec **x, int nframes, int natoms, 
+void f_gta_grid_area(const struct gta_frames *frames, 
     real cell_width, real (*fweight)(rvec, rvec), struct tessellated_grid *grid);
 /* Calculates the approximate surface area of a trajectory by tessellating the coordinates in a 3D grid.
  * Stores grid and area information in tessellated_grid *grid.
@@ -69,19 +74,32 @@ void f_gta_grid_area(rvec **x, int nframes, int natoms,
  * Memory is allocated for arrays in grid. Call free_grid when done.
  */
 
-void construct_grid(rvec **x, int nframes, int natoms, real cell_width, struct tessellated_grid *grid);
+void f_gta_grid_area_packed(const struct gta_packed_frames *packed, 
+    real cell_width, real (*fweight)(rvec, rvec), struct tessellated_grid *grid);
+/* Same as f_gta_grid_area, but for frames held in a packed frame store (see gta_frames.h).
+ */
+
+void construct_grid(const struct gta_frames *frames, real cell_width, struct tessellated_grid *grid);
 /* Memory is allocated for arrays in grid and initialized to 0.
  * Call free_grid when done with grid.
  */
 
+void construct_packed_grid(const struct gta_packed_frames *packed, real cell_width, struct tessellated_grid *grid);
+/* Same as construct_grid, decompressing one block of frames at a time.
+ */
+
 /* construct_grid must be called prior to calling the following functions */
 
-void load_grid(rvec **x, int nframes, int natoms, real (*fweight)(rvec, rvec), struct tessellated_grid *grid);
+void load_grid(const struct gta_frames *frames, real (*fweight)(rvec, rvec), struct tessellated_grid *grid);
 /* Loads the given grid with weights based on the given trajectory.
  * Uses fweight to calculate the weight of each grid point - trajectory point pair.
  * You can use one of the weight functions above for fweight.
  */
 
+void load_packed_grid(const struct gta_packed_frames *packed, real (*fweight)(rvec, rvec), struct tessellated_grid *grid);
+/* Same as load_grid, decompressing one block of frames at a time.
+ */
+
 void gen_heightmap(struct tessellated_grid *grid);
 /* Finds the z-index of the grid point with the maximum weight for each x-y column in the grid.
  * This data is stored in grid->heightmap
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ *
+ * This program uses the GROMACS molecular simulation package API.
+ * Copyright (c) 1991-2000, University of Groningen, The Netherlands.
+ * Copyright (c) 2001-2004, The GROMACS development team.
+ * Copyright (c) 2013,2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed at http://www.gromacs.org.
+ */
+
+#ifndef GTA_IO_H
+#define GTA_IO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "vec.h"
+#include "delaunay_tri.h"
+
+/* Binary triangulation container, written by any number of threads at once.
+ * All values are in the byte order of the machine that wrote the file.
+ *
+ * Header:  char magic[8] = "GTATRI1", int32 nframes, int32 nsurf, int64 table_offset
+ * Records: int32 frame, int32 surface, int32 npoints, int32 ntriangles, 
+ *          float32 points[npoints][3], int32 triangles[ntriangles][3]
+ * Table:   int64 offsets[nframes][nsurf], the byte offset of the record of each 
+ *          frame and surface (0 if it was not written), found at table_offset.
+ *
+ * A surface is one triangulated group (or leaflet of a group) of a frame.
+ * Records are in the order they were finished, so use the table to find a given frame.
+ */
+struct tri_dump {
+    int fd; // File descriptor of the open container
+    int nframes, nsurf; // Number of frames and surfaces per frame in the table
+    int64_t *offsets; // Record offsets indexed by [frame # * nsurf + surface #]
+    int64_t end; // Offset of the end of the last reserved record
+};
+
+#define TRI_DUMP_MAGIC "GTATRI1"
+
+
+void open_tri_dump(const char *fname, int nframes, int nsurf, struct tri_dump *dump);
+/* Creates a triangulation container with room in its table for nframes frames of nsurf surfaces each.
+ */
+
+void write_tri_dump(struct tri_dump *dump, 
+                    int fr, 
+                    int surf, 
+                    const rvec *x, 
+                    const struct dTriangulation *tri);
+/* Writes the triangulated points (3D coordinates from x) and triangles of a surface to the container.
+ * Each call reserves its own region at the end of the file, so it can be called by several threads at once.
+ */
+
+void close_tri_dump(struct tri_dump *dump);
+/* Writes the offset table and header and closes the container.
+ */
+
+
+/* Binary little-endian PLY mesh of the triangulated surfaces of all frames.
+ * Every frame and surface is stored as a separate patch of one mesh.
+ * Each vertex has the properties float x, y, z (nm), int frame and int surface,
+ * so that a frame can be selected by thresholding on the frame property in viewers such as ParaView.
+ * Vertices are written to the PLY file as they come, while faces are buffered in a temporary file
+ * and appended to the end when the writer is closed.
+ */
+struct ply_writer {
+    FILE *f; // The PLY file
+    FILE *faces; // Temporary file of faces
+    int64_t nverts, nfaces; // Number of vertices and faces written so far
+};
+
+
+void open_ply(const char *fname, struct ply_writer *ply);
+/* Opens a PLY file for writing triangulated surfaces.
+ */
+
+void write_ply(struct ply_writer *ply, 
+               int fr, 
+               int surf, 
+               const rvec *x, 
+               const struct dTriangulation *tri);
+/* Adds the triangles of a surface to the mesh. Can be called by several threads at once.
+ */
+
+void close_ply(struct ply_writer *ply);
+/* Appends the faces, fills in the final element counts and closes the PLY file.
+ */
+
+
+/* Binary file of per-atom values of every frame, written by any number of threads at once.
+ * All values are in the byte order of the machine that wrote the file.
+ *
+ * Header:  char magic[8], int32 nframes, int32 natoms, int32 ncols, int32 reserved
+ * Values:  float32 values[nframes][natoms][ncols]
+ *
+ * Every frame has a fixed place in the file, so frames can be written in any order.
+ * The atoms are those of every triangulated group, one group after another.
+ */
+struct atom_writer {
+    int fd; // File descriptor of the open file
+    int nframes, natoms, ncols; // Dimensions of the values
+};
+
+#define ATOM_HEADER 24 // Size of the per-atom file header in bytes
+
+
+void open_atom_file(const char *fname, 
+                    const char *magic, 
+                    int nframes, 
+                    int natoms, 
+                    int ncols, 
+                    struct atom_writer *aw);
+/* Creates a per-atom value file with the given 8-character magic string identifying its contents.
+ */
+
+void write_atom_frame(struct atom_writer *aw, int fr, const real *values);
+/* Writes the natoms * ncols values of frame fr, ordered by atom and then column.
+ * Can be called by several threads at once.
+ */
+
+void close_atom_file(struct atom_writer *aw);
+
+#endif // GTA_IO_H
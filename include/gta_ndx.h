@@ -0,0 +1,30 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_NDX_H
+#define GTA_NDX_H
+
+/* Reader of GROMACS index (NDX) files that does not need GROMACS.
+ * An index file is a list of groups, each a line "[ name ]" followed by the numbers of its atoms, starting at 1.
+ */
+
+struct ndx_group {
+    char *name;
+    int *atoms; // Index of each atom of the group, starting at 0
+    int natoms;
+};
+
+int ndx_read(const char *fname, struct ndx_group **groups, int *ngroups);
+/* Reads every group of the index file fname into *groups, in the order they appear.
+ * Returns 0 on success and -1 if the file could not be read or is not a valid index file.
+ * Memory is allocated for *groups. Call ndx_free when done.
+ */
+
+int ndx_find(const struct ndx_group *groups, int ngroups, const char *name);
+/* Returns the number of the first group named name, ignoring case, or -1 if there is none.
+ */
+
+void ndx_free(struct ndx_group *groups, int ngroups);
+
+#endif // GTA_NDX_H
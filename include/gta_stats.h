@@ -0,0 +1,92 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_STATS_H
+#define GTA_STATS_H
+
+#define STATS_MAXLEVELS 40 // Maximum number of blocking levels (blocks of up to 2^(STATS_MAXLEVELS-1) samples)
+#define STATS_MINBLOCKS 16 // Minimum number of blocks for a blocking level to be used in error estimates
+
+/* Streaming statistics of a time series.
+ * The mean and variance are updated with Welford's algorithm, and the standard error of the mean
+ * is estimated by Flyvbjerg-Petersen blocking: level l holds the statistics of the averages of 
+ * consecutive blocks of 2^l samples, so memory use is independent of the number of samples.
+ * Blocks are aligned to the start of the series, and the statistics may hold any stretch of it, 
+ * so that consecutive stretches (eg the frames of different threads) can be merged exactly: 
+ * the blocks that span two stretches are finished from the partial sums kept at either end.
+ * The struct holds no pointers, so it can be copied and saved as is.
+ */
+struct gta_stats {
+    long first; // Index in the series of the first sample
+    long n; // Number of samples
+    double mean, m2; // Running mean and sum of squared deviations from the mean
+    int nlevels; // Number of blocking levels with finished blocks
+    long bn[STATS_MAXLEVELS]; // Number of finished blocks of each level
+    double bmean[STATS_MAXLEVELS], bm2[STATS_MAXLEVELS]; // Running mean and sum of squared deviations of block averages
+    double head[STATS_MAXLEVELS]; // Sum of the samples in the first block of each level, if it started before the first sample
+    int has_head[STATS_MAXLEVELS]; // Whether the first block of each level started before the first sample and is finished
+    double tail[STATS_MAXLEVELS]; // Sum of the samples in the unfinished last block of each level
+};
+
+/* Histogram of nbins equal bins over [0, max).
+ * Histograms with the same bins (eg of different threads) can be merged.
+ */
+struct gta_hist {
+    int nbins; // Number of bins
+    double max; // Upper limit of the last bin
+    long *count; // Number of values in each bin
+    long nover; // Number of values >= max, which are not in any bin
+    long n; // Number of values added, including those >= max
+};
+
+
+void stats_init(struct gta_stats *s);
+/* Initializes empty statistics of a series.
+ */
+
+void stats_init_at(struct gta_stats *s, long first);
+/* Initializes empty statistics of the stretch of a series that starts at sample first.
+ */
+
+void stats_add(struct gta_stats *s, double x);
+/* Adds the next sample of the series.
+ */
+
+void stats_merge(struct gta_stats *dest, const struct gta_stats *src);
+/* Adds the statistics of src, the stretch of the series right after that of dest (src->first == dest->first + dest->n), 
+ * to dest. The result is that of adding the samples of both stretches in order, up to rounding.
+ */
+
+double stats_var(const struct gta_stats *s);
+/* Returns the sample variance.
+ */
+
+double stats_sem(const struct gta_stats *s);
+/* Returns the standard error of the mean, corrected for correlation between samples.
+ * This is the largest blocking estimate over the levels that have at least STATS_MINBLOCKS blocks,
+ * or the uncorrelated estimate sqrt(var/n) if there are too few samples for blocking.
+ */
+
+double stats_tau(const struct gta_stats *s);
+/* Returns the integrated autocorrelation time in samples, 
+ * estimated as (n * sem^2 / var - 1) / 2 from the blocking standard error.
+ */
+
+void hist_init(struct gta_hist *h, int nbins, double max);
+/* Initializes an empty histogram. Memory is allocated for h->count. Call hist_free when done.
+ */
+
+void hist_add(struct gta_hist *h, double x);
+/* Adds a value to the histogram. Negative values are put in the first bin.
+ */
+
+void hist_merge(struct gta_hist *dest, const struct gta_hist *src);
+/* Adds the counts of src to dest, which must have the same bins.
+ */
+
+void hist_free(struct gta_hist *h);
+/* Frees the dynamic memory in a histogram.
+ */
+
+#endif // GTA_STATS_H
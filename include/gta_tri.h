@@ -18,57 +18,251 @@
 #else
 #include "statutil.h"
 #endif
+#include "delaunay_tri.h"
+#include "gta_frames.h"
+#include "gta_stats.h"
 
 
 // Flags
 enum {
     GTA_CORRECT = 1, // Correct areas for periodic bounding conditions
     GTA_2D = 2, // Calculate 2D surface area as well
-    GTA_PRINT = 4, // Print triangle data that can be visualized using, for example, the 'showme' program
+    GTA_PRINT = 4, // Save the triangulations of all frames to a binary container (see gta_io.h)
+    GTA_LEAFLETS = 8, // Split each group into upper and lower leaflets every frame and triangulate both
+    GTA_PLY = 16, // Save the triangulated surfaces of all frames as a 3D mesh in a binary PLY file (see gta_io.h)
+    GTA_ATOMAREA = 32, // Save the area attributed to each atom in every frame to a binary file (see gta_io.h)
+    GTA_ESTOP = 64, // Stop tessellating once the standard error of the area per particle is below a tolerance (see tri_output)
+    GTA_AREAMAP = 128, // Accumulate a time-averaged map of the area per particle over the xy-plane (see area_map)
+    GTA_HIST = 256, // Accumulate histograms of the areas of triangles and lengths of edges between atoms
+    GTA_THICKNESS = 512, // Accumulate a time-averaged map of the distance between the leaflets (requires GTA_LEAFLETS, see thickness_map)
+    GTA_NEIGHBOURS = 1024, // Calculate coordination numbers and neighbour exchange between frames from the delaunay edges between atoms
+    GTA_PSI6 = 2048, // Calculate the hexatic order parameter of the atoms from the angles of the delaunay edges between them
+    GTA_ATOMPSI6 = 4096, // Save the hexatic order parameter of each atom in every frame to a binary file (requires GTA_PSI6, see gta_io.h)
+    GTA_DOMAINS = 8192, // Cluster atoms of the same lipid type connected by delaunay edges into domains (requires lipid types, see tri_output)
+    GTA_CURVATURE = 16384, // Calculate the normals and the mean and gaussian curvatures of the triangulated surfaces at the atoms
+    GTA_ATOMCURV = 32768, // Save the normal and curvatures of each atom in every frame to a binary file (requires GTA_CURVATURE, see gta_io.h)
+    GTA_FOLLOW = 65536, // The frames are a batch of a trajectory that is being followed (set by follow_area)
+    GTA_CHECKPOINT = 131072, // Periodically save the finished frames to a checkpoint file, and resume from it (see tri_output)
 };
 
-// Struct for area output data.
+// Order in which frames are tessellated with GTA_ESTOP
+enum {
+    GTA_ORDER_STRIDED = 0, // Passes over the trajectory with halving strides
+    GTA_ORDER_RANDOM, // Random permutation of the frames
+};
+
+// Which part of an index group a tri_area struct holds
+enum {
+    GTA_WHOLE = 0, // The whole group
+    GTA_UPPER, // The upper leaflet of the group (GTA_LEAFLETS)
+    GTA_LOWER, // The lower leaflet of the group (GTA_LEAFLETS)
+};
+
+// Time series of a tri_area struct whose statistics are accumulated while tessellating
+enum {
+    GTA_STAT_AREA = 0, // Triangulated 3D area
+    GTA_STAT_AREA2D, // Triangulated 2D area (GTA_2D)
+    GTA_STAT_APL, // 3D area per particle
+    GTA_STAT_BOX, // 2D area of box
+    GTA_NSTATS
+};
+
+// Time-averaged map of the area per particle over the xy-plane of the box (GTA_AREAMAP).
+// Bins are in fractional coordinates along the xy-components of the first two box vectors, so they follow box fluctuations.
+struct area_map {
+    int nx, ny; // Number of bins along the first and second box vectors
+    int nframes; // Number of frames accumulated
+    matrix box; // Average box of the accumulated frames
+    real *area; // Area attributed to the atoms in each bin, summed over frames. Indexed by [x bin * ny + y bin].
+    int *count; // Number of atoms in each bin, summed over frames. Indexed like area.
+};
+
+// Time-averaged map of the thickness of a bilayer, ie the difference between the heights of the triangulated surfaces 
+// of its upper and lower leaflets, over the xy-plane of the box (GTA_THICKNESS). Bins are as in area_map.
+struct thickness_map {
+    int nx, ny; // Number of bins along the first and second box vectors
+    int nframes; // Number of frames accumulated
+    matrix box; // Average box of the accumulated frames
+    real *thickness; // Average thickness at the centre of each bin. Indexed by [x bin * ny + y bin].
+    int *count; // Number of frames in which each bin was within both leaflets' triangulations. Indexed like thickness.
+};
+
+// Struct for area output data, one per triangulated index group.
 // These are total surface area, divide a given area by natoms to get area per particle.
 struct tri_area {
     real *area; // Triangulated 3D areas indexed by [frame #]. *area are corrected areas for periodic bounds if GTA_CORRECT was used.
     real *area2D; // Triangulated 2D areas indexed by [frame #]. NULL if GTA_2D not set.
     real *area2Dbox; // 2D areas of box for each frame.
-    int natoms, nframes; // Number of atoms and number of frames, respectively, that were triangulated.
+    real *time; // Time of each frame (ps), as read from the trajectory.
+    int *natoms_fr; // Number of atoms triangulated in each frame. NULL unless GTA_LEAFLETS was used, otherwise natoms are triangulated every frame.
+    real *type_area; // Area attributed to the atoms of each lipid type, indexed by [frame # * ntypes + type #]. NULL if ntypes is 0.
+    int *type_natoms; // Number of triangulated atoms of each lipid type, indexed like type_area.
+    int ntypes; // Number of lipid types (see tri_output)
+    real *coord; // Average number of delaunay neighbours per atom in each frame. NULL unless GTA_NEIGHBOURS was used.
+    real *exchange; // Fraction of the neighbour pairs of the previous frame that are no longer neighbours in each frame, 
+                    // -1 if the previous frame was not tessellated. NULL unless GTA_NEIGHBOURS was used.
+    real *psi6; // Average magnitude of the atoms' hexatic order parameters in each frame. NULL unless GTA_PSI6 was used.
+    real *mean_curv, *gauss_curv; // Average mean (1/nm) and gaussian (1/nm^2) curvature of the interior atoms in each frame. 
+                                  // NULL unless GTA_CURVATURE was used.
+    int *ndomains; // Number of domains of each lipid type, indexed by [frame # * ntypes + type #]. NULL unless GTA_DOMAINS was used.
+    int *largest; // Number of atoms in the largest domain of each lipid type, indexed like ndomains
+    real *largest_area; // Area of the atoms in the largest domain of each lipid type, indexed like ndomains
+    long *domain_sizes; // Number of domains of each lipid type and size summed over frames, indexed by [type # * (natoms + 1) + size]
+    int natoms, nframes; // Number of atoms in the group and number of frames, respectively, that were triangulated.
+    int leaflet; // GTA_WHOLE, GTA_UPPER or GTA_LOWER
+    unsigned char *done; // Whether each frame was tessellated. NULL if all were, otherwise areas of other frames are 0 (GTA_ESTOP).
+    struct area_map map; // Area per particle map. Arrays are NULL unless GTA_AREAMAP was used.
+    struct thickness_map thick; // Thickness map. Arrays are NULL unless GTA_THICKNESS was used, and for lower leaflets.
+    struct gta_hist tri_hist, edge_hist; // Histograms of the areas of triangles and lengths of edges between atoms over all frames.
+                                         // count is NULL unless GTA_HIST was used.
+    struct gta_stats stats[GTA_NSTATS]; // Statistics of the area time series, indexed by GTA_STAT_*
+    real area_modulus; // Area compressibility modulus in kJ/mol/nm^2 from the box area fluctuations. 0 if no temperature was given.
 };
 
+// Options for the optional outputs and modes selected by flags.
+struct tri_output {
+    const char *dump_fname; // Triangulation container file name (GTA_PRINT)
+    const char *ply_fname; // PLY mesh file name (GTA_PLY)
+    const char *atom_area_fname; // Per-atom area file name (GTA_ATOMAREA)
+    const char *atom_psi6_fname; // Per-atom hexatic order parameter file name (GTA_ATOMPSI6)
+    const char *atom_curv_fname; // Per-atom normal and curvature file name (GTA_ATOMCURV)
+    int ntypes; // Number of lipid types by which to aggregate per-atom areas. 0 for none.
+    int **types; // Lipid type of each atom indexed by [group #][atom # in group], -1 for none.
+                 // Set by tessellate_area from ntypes further groups of the index file.
+    real temp; // Temperature in K for the area compressibility modulus. 0 for none.
+    real tol; // Tolerance of the standard error of the mean area per particle (GTA_ESTOP)
+    int order; // GTA_ORDER_STRIDED or GTA_ORDER_RANDOM (GTA_ESTOP)
+    unsigned int seed; // Seed of the random frame order (GTA_ORDER_RANDOM)
+    int map_bins; // Number of bins along each box vector of the area and thickness maps (GTA_AREAMAP, GTA_THICKNESS)
+    int hist_bins; // Number of bins of the triangle area and edge length histograms (GTA_HIST)
+    real hist_area_max, hist_edge_max; // Upper limits of the triangle area and edge length histograms (GTA_HIST)
+    const char *cpt_fname; // Checkpoint file name (GTA_CHECKPOINT)
+    real cpt_period; // Minutes between checkpoints, 0 to save one after every frame (GTA_CHECKPOINT)
+};
+
+/* Checkpoint file, in the byte order and precision of the machine that wrote it:
+ *
+ * Header:  char magic[8] = "GTACPT2", int32 sizeof(real), int32 nframes, int32 nareas, int32 ntypes, 
+ *          uint32 flags (those of GTA_CORRECT, GTA_2D, GTA_LEAFLETS, GTA_PSI6 and GTA_CURVATURE), real espace, 
+ *          int32 natoms[nareas], real times[nframes], 
+ *          uint8 done[(nframes + 7) / 8] (bit fr % 8 of byte fr / 8 is set if frame fr is finished)
+ * Frames:  For each finished frame in order, and each surface: real area, real area2Dbox, 
+ *          real area2D (GTA_2D), int32 natoms_fr (GTA_LEAFLETS), real type_area[ntypes], int32 type_natoms[ntypes], 
+ *          real psi6 (GTA_PSI6), real mean_curv, real gauss_curv (GTA_CURVATURE)
+ */
+
 
 void tessellate_area(const char *traj_fname, 
                      const char *ndx_fname, 
+                     int ngroups, 
+                     const struct frame_range *range, 
+                     const char *raw_fname, 
                      output_env_t *oenv, 
                      real espace, 
                      int nthreads, 
                      struct tri_area *areas, 
-                     unsigned char flags);
-/* Reads a trajectory file and tessellates all of its frames.
- * If ndx_fname is not null, only a selection within the trajectory will be tessellated.
+                     const struct tri_output *out, 
+                     unsigned long flags);
+/* Reads a trajectory file and tessellates all of its frames in range, or every frame if range is NULL (see gta_frames.h).
+ * If ndx_fname is not null, ngroups selections within the trajectory will be tessellated separately,
+ * with the trajectory being read only once. Otherwise, ngroups must be 1 and the whole system is tessellated.
+ * areas must point to an array of ngroups tri_area structs, one for each selected group, 
+ * or of 2 * ngroups structs if GTA_LEAFLETS is set (the upper and then the lower leaflet of each group).
+ * If out->ntypes is not 0, another ntypes groups are selected from the index file as lipid types, 
+ * and the per-atom areas are aggregated by type. An atom in several type groups is of the first one.
+ * If raw_fname is not NULL, the selected atoms are read from or saved to this raw trajectory file (see read_frames).
  * output_env_t *oenv is needed for reading trajectory files.
- * You can initialize one using output_env_init() in Gromacs's oenv.h.
+ * You can initialize one using output_env_init() in Gromacs's oenv.h. Without Gromacs (see lite/) it is not used and can be NULL.
  * Calls the delaunay_tessellate function below.
  */
 
-void delaunay_tessellate(rvec **x, 
-                         matrix *box, 
+void follow_area(const char *traj_fname, 
+                 const char *ndx_fname, 
+                 int ngroups, 
+                 const char *out_fname, 
+                 real wait, 
+                 int nflush, 
+                 real espace, 
+                 int nthreads, 
+                 struct tri_area *areas, 
+                 const struct tri_output *out, 
+                 unsigned long flags);
+/* Follows an XTC file that is still being written, eg by a running simulation, and tessellates its frames as they appear. 
+ * The groups are selected as in tessellate_area. Whenever new frames have been written, they are read, 
+ * tessellated together by delaunay_tessellate and their rows appended to the output file out_fname, 
+ * in the format of print_areas. The output file is flushed once nflush rows have been appended since it last was, 
+ * so it can be read while the analysis runs. Following stops once no frame has been added for wait seconds.
+ * Only the per-frame areas and the flags that need no other frames or output files can be followed: 
+ * GTA_CORRECT, GTA_2D, GTA_LEAFLETS, GTA_PSI6 and GTA_CURVATURE, and lipid types.
+ * The statistics of the areas are accumulated over all of the frames and logged at the end; the arrays of areas 
+ * hold the values of the last batch of frames. Call free_tri_area on each when done.
+ */
+
+void delaunay_tessellate(const struct gta_frames *frames, 
                          real espace, 
                          int nthreads, 
+                         int ngroups, 
                          struct tri_area *areas, 
-                         unsigned char flags);
+                         const struct tri_output *out, 
+                         unsigned long flags);
 /* Tesssellates all of the frames in the given trajectory using delaunay triangulation.
+ * Each frame of frames holds the coordinates of ngroups groups, one group after another, 
+ * and every group is tessellated separately within the same pass over the frames.
+ * areas is an array of ngroups tri_area structs (2 * ngroups if GTA_LEAFLETS is set, see tessellate_area) 
+ * whose natoms and nframes must be set before calling.
  * espace is the spacing of the edge correction point intervals if using the GTA_CORRECT flag.
+ * out holds the options of the outputs selected by flags, and may be NULL if none are selected.
  * nthreads is the number of threads to be used if built with openmp.
  * nthreads <= 0 will use all available threads.
- * Memory is allocated for arrays in the tri_area struct. Call free_tri_area when done.
+ * Memory is allocated for arrays in the tri_area structs. Call free_tri_area on each when done.
+ * The statistics of the areas are accumulated by each thread over its stretch of frames as they are tessellated, 
+ * and the stretches are merged in frame order at the end, so they do not need the stored areas 
+ * and do not depend on the number of threads.
+ * With GTA_ESTOP, frames are instead tessellated in strided or random order (out->order) until the standard error 
+ * of the mean area per particle of every surface, estimated by block averaging the tessellated frames in time order, 
+ * is below out->tol. The tessellated frames are then marked in the done arrays of the tri_area structs.
+ * With GTA_AREAMAP, the area of each triangle is split between its atoms as in tri_surface_area 
+ * and binned by atom position into a histogram per thread, which are summed into the map of each tri_area at the end.
+ * Likewise with GTA_HIST, each thread fills its own triangle area and edge length histograms, merged at the end.
+ * Only triangles and edges between atoms are counted, not those of edge correction points.
+ * With GTA_NEIGHBOURS, the neighbour pairs of each frame are kept as sorted edge keys of the atoms' indices in the group, 
+ * and merged with those of the previous frame if the same thread tessellated it. Otherwise they are compared after the frame loop.
+ * With GTA_PSI6, the hexatic order parameter psi6 = <exp(6i theta)> of each atom is found from the xy-angles theta of its delaunay edges 
+ * to other atoms, and its magnitude averaged over the atoms of each frame.
+ * With GTA_DOMAINS, the atoms of each lipid type are clustered into domains by a union-find over the delaunay edges 
+ * joining atoms of the same type, and the domain size distributions of each thread are summed at the end.
+ * With GTA_CURVATURE, the curvatures of each surface are found with tri_surface_curvature and averaged over its interior atoms.
+ * With GTA_THICKNESS, the heights of both leaflets of each group are interpolated at the bin centres 
+ * with tri_surface_heights every frame, and their differences summed per thread into the upper leaflet's thickness map.
+ * With GTA_CHECKPOINT, the values of the finished frames are saved to out->cpt_fname every out->cpt_period 
+ * minutes and at the end. If that file already holds a checkpoint of the same frames, groups and flags, its finished frames 
+ * are restored and not tessellated again, with any number of threads. The restored values are added to the statistics 
+ * in frame order like those of the other frames, so the statistics are those of an uninterrupted run. 
+ * Only the flags that need no other outputs or accumulators can be checkpointed: 
+ * GTA_CORRECT, GTA_2D, GTA_LEAFLETS, GTA_PSI6 and GTA_CURVATURE, and lipid types.
  * See above for flags.
  */
 
+void split_leaflets(const rvec *x, 
+                    int natoms, 
+                    matrix box, 
+                    rvec *x_upper, 
+                    int *ind_upper, 
+                    int *n_upper, 
+                    rvec *x_lower, 
+                    int *ind_lower, 
+                    int *n_lower);
+/* Splits the given coordinates of a bilayer into its upper and lower leaflets 
+ * by their z-coordinate relative to the bilayer centre (the mean z-coordinate of all the given atoms).
+ * The bilayer should not be split across the box's z-boundary, ie the trajectory should be centered on the bilayer.
+ * x_upper and x_lower must each have space for natoms coordinates.
+ * The index in x of each atom copied to x_upper and x_lower is stored in ind_upper and ind_lower, which can be NULL.
+ */
+
 void delaunay_surface_area(const rvec *x, 
                            matrix box, 
                            int natoms, 
-                           unsigned char flags, 
+                           unsigned long flags, 
                            real *a2D, 
                            real *a3D);
 /* Tessellates the given array of coordinates using delaunay triangulation 
@@ -77,8 +271,87 @@ void delaunay_surface_area(const rvec *x,
  * See above for flags.
  */
 
-void print_areas(const char *fname, const struct tri_area *areas);
-/* Formats and prints the data in a tri_area struct to an output file.
+void delaunay_triangulate(const rvec *x, 
+                          int natoms, 
+                          struct dTriangulation *tri);
+/* Triangulates the projection of the given coordinates onto the xy-plane.
+ * The triangles in tri index the given coordinates, and tri->points is left NULL.
+ * Memory is allocated for tri->triangles. free() it when done.
+ */
+
+void tri_surface_area(const rvec *x, 
+                      const struct dTriangulation *tri, 
+                      int natoms, 
+                      real *a2D, 
+                      real *a3D, 
+                      real *atom_area, 
+                      struct gta_hist *hist);
+/* Calculates the 2D and 3D area of the given triangulation of x, stored in a2D and a3D.
+ * If atom_area is not NULL, the 3D area of each triangle is also split evenly between those of its vertices 
+ * that are among the first natoms points of x (ie not edge correction points) and added to atom_area[vertex].
+ * atom_area must have room for natoms values. Any other triangles' areas are not attributed to atoms.
+ * If hist is not NULL, the 3D area of each triangle between three of the first natoms points is added to it.
+ * a2D, a3D, atom_area and/or hist can be NULL.
+ */
+
+void tri_surface_curvature(const rvec *x, 
+                           const struct dTriangulation *tri, 
+                           int natoms, 
+                           rvec *normals, 
+                           real *mean, 
+                           real *gauss, 
+                           int *interior);
+/* Calculates the unit normal and the discrete mean and gaussian curvature of the triangulated surface of x 
+ * at each of its first natoms points, in a single pass over the triangles. Normals are area-weighted averages 
+ * of the normals of the triangles, pointing towards +z. The mean curvature is from the cotangent Laplacian of the positions, 
+ * positive where the surface bulges towards the normal, and the gaussian curvature is the angle deficit, 
+ * both over a third of the area of the triangles around each point.
+ * Curvatures are 0 at points on the boundary of the triangulation (eg at the edges of the box unless edge correction points 
+ * were added), which are marked with 0 in interior (can be NULL). normals, mean and gauss must each have room for natoms values.
+ */
+
+void tri_surface_heights(const rvec *x, 
+                         int npoints, 
+                         const struct dTriangulation *tri, 
+                         const rvec *q, 
+                         int nq, 
+                         real *z, 
+                         int *inside);
+/* Interpolates the height (z-coordinate) of the triangulated surface of the npoints points x linearly 
+ * at the xy-positions of nq query points q, eg protein atoms, the atoms of another leaflet or the nodes of a grid. 
+ * The height at each query point is stored in z, and whether it lies within the triangulation in inside (can be NULL). 
+ * Query points outside of the triangulation get a height of 0.
+ * A point locator (see dtLocator) is built from the triangulation, so each query takes O(1) expected time.
+ */
+
+void print_areas(const char *fname, int ngroups, const struct tri_area *areas);
+/* Formats and prints the data in an array of ngroups tri_area structs to an output file 
+ * (only the tessellated frames if done is set),
+ * and logs the statistics of each.
+ */
+
+void print_area_map(const char *fname, int ngroups, const struct tri_area *areas);
+/* Prints the time-averaged area per particle maps of an array of ngroups tri_area structs 
+ * (2 * ngroups with GTA_LEAFLETS) to a text file, one block per surface.
+ * Each line holds the x and y coordinates of the centre of a bin in the average box, 
+ * the average area per particle in the bin and the average number of particles in the bin per frame.
+ */
+
+void print_thickness_map(const char *fname, int ngroups, const struct tri_area *areas);
+/* Prints the time-averaged thickness maps of an array of 2 * ngroups tri_area structs (GTA_LEAFLETS) 
+ * to a text file, one block per group. Each line holds the x and y coordinates of the centre of a bin in the average box, 
+ * the average thickness and the fraction of frames in which the bin was within both leaflets.
+ */
+
+void print_domain_sizes(const char *fname, int ngroups, const struct tri_area *areas);
+/* Prints the average number of domains of each size and lipid type per frame of an array of ngroups tri_area structs 
+ * (2 * ngroups with GTA_LEAFLETS) to a text file, one column per surface and type (GTA_DOMAINS).
+ */
+
+void print_histograms(const char *fname, int ngroups, const struct tri_area *areas);
+/* Prints the triangle area and edge length histograms of an array of ngroups tri_area structs 
+ * (2 * ngroups with GTA_LEAFLETS) to a text file as probability densities, one column per surface.
+ * The header of each column holds the number of values and the number beyond the last bin.
  */
 
 void free_tri_area(struct tri_area *areas);
@@ -98,5 +371,11 @@ static inline real area_tri(const rvec a,
     return norm(cpr) / 2.0;
 }
 
+/* Calculates the area of the projection of a (possibly triclinic) box onto the xy-plane.
+ */
+static inline real area_box2D(matrix box) {
+    return box[XX][XX] * box[YY][YY] - box[XX][YY] * box[YY][XX];
+}
+
 
 #endif // GTA_TRI_H
\ No newline at end of file
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_TRR_H
+#define GTA_TRR_H
+
+#include <stdio.h>
+
+/* Reader of GROMACS TRR trajectories that does not need GROMACS.
+ * A TRR frame is a header followed by uncompressed XDR blocks of reals, in single or double precision:
+ * the box, virial, pressure, coordinates, velocities and forces, each of which may be missing.
+ * Values in double precision are converted to single precision.
+ */
+
+/* Header of a TRR frame.
+ */
+struct trr_header {
+    int natoms, step;
+    float time, lambda;
+    int is_double; // Whether the reals of the frame are in double precision
+    int box_size, vir_size, pres_size, x_size, v_size, f_size; // Size in bytes of each block of the frame, 0 if it is missing
+};
+
+int trr_read_header(FILE *f, struct trr_header *hdr);
+/* Reads the header of the frame at the current position of f.
+ * Returns 1 if a header was read, 0 at the end of the file and -1 if f is not at a valid TRR frame.
+ */
+
+int trr_read_data(FILE *f, const struct trr_header *hdr, float box[3][3], float *x);
+/* Reads the blocks of the frame whose header hdr was just read from f, storing its box in box and its coordinates
+ * in x (3 floats per atom) if the frame has them and box or x is not NULL, and moves f past the frame.
+ * Returns 0 on success and -1 on error.
+ */
+
+#endif // GTA_TRR_H
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_XTC_H
+#define GTA_XTC_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Reader of GROMACS XTC trajectories that does not need GROMACS.
+ * Unlike the GROMACS reader, which decompresses into static buffers, all decoding state is kept in
+ * struct xtc_decoder, so frames can be decoded by several threads at once, each with its own
+ * decoder and FILE. Frames are found through an index of their byte offsets, built by reading
+ * only the frame headers and skipping over the compressed coordinates.
+ * Functions return 0 on success and -1 if the file could not be read or is not a valid XTC file.
+ */
+
+/* Byte offset, time and box of every frame of an XTC file.
+ */
+struct xtc_index {
+    int64_t *offsets; // Byte offset of each frame in the file
+    int *steps; // Simulation step of each frame
+    float *times; // Time of each frame (ps)
+    float (*boxes)[3][3]; // Box of each frame (nm)
+    int nframes;
+    int natoms;
+    int64_t file_size, mtime_sec, mtime_nsec; // Size and modification time of the file when the index was built
+};
+
+/* Scratch buffers for decompressing coordinates, grown as needed.
+ */
+struct xtc_decoder {
+    unsigned char *bytes; // Compressed coordinates of the frame being decoded
+    size_t nbytes; // Size of bytes
+    int *ints; // Integer coordinates of the frame being decoded
+    int nints; // Size of ints
+};
+
+int xtc_build_index(const char *fname, struct xtc_index *index);
+/* Finds the frames of the XTC file fname and stores them in index.
+ * An incomplete last frame is left out, as the GROMACS reader stops at it.
+ * Memory is allocated for the arrays of index. Call xtc_free_index when done.
+ */
+
+int xtc_cached_index(const char *fname, struct xtc_index *index, int *cached);
+/* Like xtc_build_index, but first tries to load the index from the file fname.gtaidx, 
+ * which is only used if it was saved for the same size and modification time of fname.
+ * Otherwise the index is built and saved to fname.gtaidx for later calls, if the file can be written, 
+ * fname did not change while its frames were found and it does not end in an incomplete frame. 
+ * *cached is set to whether the index was loaded.
+ *
+ * Index file, in the byte order of the machine that wrote it:
+ * char magic[8] = "GTAXIDX", int64 file_size, int64 mtime_sec, int64 mtime_nsec, int32 nframes, int32 natoms, 
+ * int64 offsets[nframes], int32 steps[nframes], float32 times[nframes], float32 boxes[nframes][3][3]
+ */
+
+void xtc_free_index(struct xtc_index *index);
+
+void xtc_decoder_init(struct xtc_decoder *dec);
+
+void xtc_decoder_free(struct xtc_decoder *dec);
+
+int xtc_read_frame(FILE *f, struct xtc_decoder *dec, int natoms, int *step, float *time, float box[3][3], float *x);
+/* Reads the frame at the current position of f into x (3 floats per atom), and its step, time and box
+ * if those are not NULL. natoms must be the number of atoms in the frame.
+ * Returns 1 if a frame was read, 0 at the end of the file and -1 on error.
+ */
+
+int xtc_skip_frame(FILE *f, int *natoms, int *step, float *time, float box[3][3]);
+/* Reads the header of the frame at the current position of f, storing its number of atoms, step, time and box
+ * if those are not NULL, and moves f past the frame's coordinates without decompressing them.
+ * Returns 1 if a frame was skipped, 0 at the end of the file and -1 on error.
+ */
+
+#endif // GTA_XTC_H
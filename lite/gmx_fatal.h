@@ -0,0 +1,16 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_LITE_GMX_FATAL_H
+#define GTA_LITE_GMX_FATAL_H
+
+#include <errno.h>
+
+#define FARGS 0, __FILE__, __LINE__ // The first three arguments of gmx_fatal
+
+void gmx_fatal(int fatal_errno, const char *file, int line, const char *fmt, ...);
+/* Prints the error message and the source file and line it was raised at to stderr, and exits.
+ */
+
+#endif // GTA_LITE_GMX_FATAL_H
@@ -0,0 +1,367 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+/* The parts of the GROMACS API used by g_tessla, for builds without GROMACS (make VGRO=0).
+ * Trajectories and index files are read with the GROMACS-free readers of gta_xtc.h, gta_trr.h and gta_ndx.h.
+ */
+
+#define _FILE_OFFSET_BITS 64 // for files over 2 GB
+#define _XOPEN_SOURCE 700 // for fseeko and strdup
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "gmx_fatal.h"
+#include "index.h"
+#include "pargs.h"
+#include "smalloc.h"
+#include "trxio.h"
+#include "vec.h"
+#include "gta_ndx.h"
+#include "gta_trr.h"
+#include "gta_xtc.h"
+
+struct t_trxstatus {
+    FILE *f;
+    int is_xtc; // XTC or TRR
+    int natoms;
+    struct xtc_decoder dec;
+    float *x; // Coordinates of the frame being read
+};
+
+static int find_option(const char *opt, int nfile, const t_filenm fnm[]);
+/* Returns the index of the file option opt in fnm. Exits with an error if there is none.
+ */
+
+static int set_parg(t_pargs *pa, const char *arg, const char *value);
+/* Sets the option pa to the value given on the command line for arg, which is NULL if arg was the last argument.
+ * Returns the number of arguments used for the value (0 or 1). Exits with an error if there is no valid value.
+ */
+
+static void print_help(const char *program, int nfile, const t_filenm fnm[], int npargs, const t_pargs *pa,
+                       int ndesc, const char **desc);
+/* Prints the description, files and options of the program.
+ */
+
+static int read_frame(t_trxstatus *status, real *t, rvec *x, matrix box);
+/* Reads the next frame with coordinates. Returns 1 if one was read, 0 at the end of the file and -1 on error.
+ */
+
+
+void gmx_fatal(int fatal_errno, const char *file, int line, const char *fmt, ...) {
+    va_list arg;
+    fprintf(stderr, "\nFatal error in source file %s, line %d:\n", file, line);
+    va_start(arg, fmt);
+    vfprintf(stderr, fmt, arg);
+    va_end(arg);
+    if(fatal_errno != 0) {
+        fprintf(stderr, "(%s)\n", strerror(fatal_errno));
+    }
+    exit(1);
+}
+
+void *save_calloc(const char *name, const char *file, int line, size_t n, size_t size) {
+    if(n == 0 || size == 0)     return NULL;
+    void *p = calloc(n, size);
+    if(p == NULL) {
+        gmx_fatal(errno, file, line, "Not enough memory for %zu bytes of %s.\n", n * size, name);
+    }
+    return p;
+}
+
+void *save_realloc(const char *name, const char *file, int line, void *ptr, size_t n, size_t size) {
+    if(n == 0 || size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    void *p = realloc(ptr, n * size);
+    if(p == NULL) {
+        gmx_fatal(errno, file, line, "Not enough memory for %zu bytes of %s.\n", n * size, name);
+    }
+    return p;
+}
+
+void save_free(const char *name, const char *file, int line, void *ptr) {
+    free(ptr);
+}
+
+
+gmx_bool parse_common_args(int *argc, char *argv[], unsigned long Flags, int nfile, t_filenm fnm[], int npargs, t_pargs *pa,
+                           int ndesc, const char **desc, int nbugs, const char **bugs, output_env_t *oenv) {
+    *oenv = NULL;
+    for(int i = 1; i < *argc; ++i) {
+        const char *arg = argv[i];
+        const char *next = (i + 1 < *argc) ? argv[i + 1] : NULL;
+        int found = 0;
+
+        if(strcmp(arg, "-h") == 0 || strcmp(arg, "-help") == 0) {
+            print_help(argv[0], nfile, fnm, npargs, pa, ndesc, desc);
+            exit(0);
+        }
+
+        for(int f = 0; f < nfile && !found; ++f) {
+            if(strcmp(arg, fnm[f].opt) == 0) {
+                fnm[f].flag |= ffSET;
+                if(next != NULL && next[0] != '-') { // otherwise the default file name
+                    fnm[f].fn = next;
+                    ++i;
+                }
+                found = 1;
+            }
+        }
+        for(int p = 0; p < npargs && !found; ++p) {
+            if(strcmp(arg, pa[p].option) == 0) {
+                i += set_parg(&pa[p], arg, next);
+                pa[p].bSet = TRUE;
+                found = 1;
+            }
+            else if(pa[p].type == etBOOL && strncmp(arg, "-no", 3) == 0 && strcmp(arg + 3, pa[p].option + 1) == 0) {
+                *pa[p].u.b = FALSE;
+                pa[p].bSet = TRUE;
+                found = 1;
+            }
+        }
+        if(!found) {
+            gmx_fatal(FARGS, "Unknown command line option %s. Use -h for the list of options.\n", arg);
+        }
+    }
+
+    for(int p = 0; p < npargs; ++p) {
+        if(pa[p].type == etENUM && pa[p].u.enumc[0] == NULL) { // the first choice by default
+            pa[p].u.enumc[0] = pa[p].u.enumc[1];
+        }
+    }
+    return TRUE;
+}
+
+const char *opt2fn(const char *opt, int nfile, const t_filenm fnm[]) {
+    return fnm[find_option(opt, nfile, fnm)].fn;
+}
+
+const char *opt2fn_null(const char *opt, int nfile, const t_filenm fnm[]) {
+    const t_filenm *f = &fnm[find_option(opt, nfile, fnm)];
+    return ((f->flag & ffOPT) && !(f->flag & ffSET)) ? NULL : f->fn;
+}
+
+gmx_bool opt2bSet(const char *opt, int nfile, const t_filenm fnm[]) {
+    return (fnm[find_option(opt, nfile, fnm)].flag & ffSET) != 0;
+}
+
+gmx_bool opt2parg_bSet(const char *option, int nparg, const t_pargs pa[]) {
+    for(int p = 0; p < nparg; ++p) {
+        if(strcmp(pa[p].option, option) == 0)  return pa[p].bSet;
+    }
+    gmx_fatal(FARGS, "No option %s.\n", option);
+    return FALSE;
+}
+
+
+int read_first_x(const output_env_t oenv, t_trxstatus **status, const char *fn, real *t, rvec **x, matrix box) {
+    const char *ext = strrchr(fn, '.');
+    t_trxstatus *s;
+
+    snew(s, 1);
+    if(ext != NULL && strcasecmp(ext, ".xtc") == 0)     s->is_xtc = 1;
+    else if(ext == NULL || strcasecmp(ext, ".trr") != 0) {
+        gmx_fatal(FARGS, "Cannot read %s: only XTC and TRR trajectories can be read without GROMACS.\n", fn);
+    }
+    s->f = fopen(fn, "rb");
+    if(s->f == NULL) {
+        gmx_fatal(errno, __FILE__, __LINE__, "Cannot open %s.\n", fn);
+    }
+    xtc_decoder_init(&s->dec);
+
+    // The number of atoms is that of the first frame
+    int ret;
+    if(s->is_xtc) {
+        ret = xtc_skip_frame(s->f, &s->natoms, NULL, NULL, NULL);
+    }
+    else {
+        struct trr_header hdr;
+        ret = trr_read_header(s->f, &hdr);
+        s->natoms = hdr.natoms;
+    }
+    if(ret <= 0 || fseeko(s->f, 0, SEEK_SET) != 0) {
+        gmx_fatal(FARGS, "%s is not a valid %s file.\n", fn, s->is_xtc ? "XTC" : "TRR");
+    }
+
+    snew(s->x, 3 * s->natoms);
+    snew(*x, s->natoms);
+    if(read_frame(s, t, *x, box) <= 0) {
+        gmx_fatal(FARGS, "No frames with coordinates could be read from %s.\n", fn);
+    }
+    *status = s;
+    return s->natoms;
+}
+
+gmx_bool read_next_x(const output_env_t oenv, t_trxstatus *status, real *t, rvec x[], matrix box) {
+    int ret = read_frame(status, t, x, box);
+    if(ret < 0) {
+        fprintf(stderr, "\nWARNING: Incomplete or invalid frame after time %g, the trajectory is read up to there.\n", *t);
+    }
+    return ret > 0;
+}
+
+void close_trx(t_trxstatus *status) {
+    fclose(status->f);
+    xtc_decoder_free(&status->dec);
+    sfree(status->x);
+    sfree(status);
+}
+
+
+void rd_index(const char *statfile, int ngrps, int isize[], atom_id *index[], char *grpnames[]) {
+    struct ndx_group *groups;
+    int ngroups;
+
+    if(ndx_read(statfile, &groups, &ngroups) != 0 || ngroups == 0) {
+        gmx_fatal(FARGS, "Cannot read the index groups of %s.\n", statfile);
+    }
+    for(int g = 0; g < ngroups; ++g) {
+        fprintf(stderr, "Group %5d (%15s) has %5d elements\n", g, groups[g].name, groups[g].natoms);
+    }
+
+    for(int i = 0; i < ngrps; ++i) {
+        char sel[256];
+        int g = -1;
+
+        fprintf(stderr, "Select a group: ");
+        while(g < 0) {
+            if(scanf("%255s", sel) != 1) {
+                gmx_fatal(FARGS, "Could not read the selection of group %d of %d.\n", i + 1, ngrps);
+            }
+            char *end;
+            long n = strtol(sel, &end, 10);
+            g = (*end == '\0') ? ((n >= 0 && n < ngroups) ? (int)n : -1) : ndx_find(groups, ngroups, sel);
+            if(g < 0) {
+                fprintf(stderr, "Error: No such group '%s'\nSelect a group: ", sel);
+            }
+        }
+        fprintf(stderr, "Selected %d: '%s'\n", g, groups[g].name);
+
+        isize[i] = groups[g].natoms;
+        snew(index[i], groups[g].natoms);
+        for(int j = 0; j < groups[g].natoms; ++j) {
+            index[i][j] = groups[g].atoms[j];
+        }
+        if(grpnames)    grpnames[i] = strdup(groups[g].name);
+    }
+
+    ndx_free(groups, ngroups);
+}
+
+
+static int find_option(const char *opt, int nfile, const t_filenm fnm[]) {
+    for(int f = 0; f < nfile; ++f) {
+        if(strcmp(opt, fnm[f].opt) == 0)    return f;
+    }
+    gmx_fatal(FARGS, "No file option %s.\n", opt);
+    return -1;
+}
+
+static int set_parg(t_pargs *pa, const char *arg, const char *value) {
+    char *end = NULL;
+
+    if(pa->type == etBOOL) { // -option alone sets it, or -option yes/no
+        if(value != NULL && (strcasecmp(value, "yes") == 0 || strcasecmp(value, "no") == 0)) {
+            *pa->u.b = strcasecmp(value, "yes") == 0;
+            return 1;
+        }
+        *pa->u.b = TRUE;
+        return 0;
+    }
+    if(value == NULL) {
+        gmx_fatal(FARGS, "Option %s needs a value.\n", arg);
+    }
+
+    switch(pa->type) {
+        case etINT:
+            *pa->u.i = (int)strtol(value, &end, 10);
+            break;
+        case etREAL:
+        case etTIME:
+            *pa->u.r = (real)strtod(value, &end);
+            break;
+        case etSTR:
+            *pa->u.c = value;
+            return 1;
+        case etENUM:
+            for(int e = 1; pa->u.enumc[e] != NULL; ++e) {
+                if(strcasecmp(pa->u.enumc[e], value) == 0) {
+                    pa->u.enumc[0] = pa->u.enumc[e];
+                    return 1;
+                }
+            }
+            gmx_fatal(FARGS, "Invalid value %s of option %s.\n", value, arg);
+            break;
+        default:
+            gmx_fatal(FARGS, "Options like %s are not supported without GROMACS.\n", arg);
+    }
+    if(end == value || *end != '\0') {
+        gmx_fatal(FARGS, "Invalid value %s of option %s.\n", value, arg);
+    }
+    return 1;
+}
+
+static void print_help(const char *program, int nfile, const t_filenm fnm[], int npargs, const t_pargs *pa,
+                       int ndesc, const char **desc) {
+    printf("%s\n\nDESCRIPTION\n\n", program);
+    for(int i = 0; i < ndesc; ++i) {
+        fputs(desc[i], stdout);
+    }
+    printf("\n\nFILES\n\n");
+    for(int f = 0; f < nfile; ++f) {
+        printf("%-10s %-24s %s%s\n", fnm[f].opt, fnm[f].fn,
+            (fnm[f].flag & ffWRITE) ? "output" : "input", (fnm[f].flag & ffOPT) ? ", optional" : "");
+    }
+    printf("\nOPTIONS\n\n");
+    for(int p = 0; p < npargs; ++p) {
+        char value[64] = "";
+        switch(pa[p].type) {
+            case etINT:     snprintf(value, sizeof(value), "%d", *pa[p].u.i); break;
+            case etREAL:
+            case etTIME:    snprintf(value, sizeof(value), "%g", *pa[p].u.r); break;
+            case etSTR:     snprintf(value, sizeof(value), "%s", *pa[p].u.c ? *pa[p].u.c : ""); break;
+            case etBOOL:    snprintf(value, sizeof(value), "%s", *pa[p].u.b ? "yes" : "no"); break;
+            case etENUM:    snprintf(value, sizeof(value), "%s", pa[p].u.enumc[1]); break;
+        }
+        printf("%-10s %-10s %s\n", pa[p].option, value, pa[p].desc);
+    }
+}
+
+static int read_frame(t_trxstatus *status, real *t, rvec *x, matrix box) {
+    float time, b[3][3];
+    int ret;
+
+    if(status->is_xtc) { // fails if the number of atoms changes
+        ret = xtc_read_frame(status->f, &status->dec, status->natoms, NULL, &time, b, status->x);
+        if(ret <= 0)    return ret;
+    }
+    else {
+        struct trr_header hdr;
+        do { // frames with only velocities or forces are skipped
+            ret = trr_read_header(status->f, &hdr);
+            if(ret <= 0)    return ret;
+            if(hdr.natoms != status->natoms)    return -1;
+            if(trr_read_data(status->f, &hdr, b, hdr.x_size ? status->x : NULL) != 0)  return -1;
+        } while(hdr.x_size == 0);
+        time = hdr.time;
+        if(hdr.box_size == 0)   memset(b, 0, sizeof(b));
+    }
+
+    *t = time;
+    for(int i = 0; i < DIM; ++i) {
+        for(int j = 0; j < DIM; ++j) {
+            box[i][j] = b[i][j];
+        }
+    }
+    for(int i = 0; i < status->natoms; ++i) {
+        x[i][XX] = status->x[3 * i];
+        x[i][YY] = status->x[3 * i + 1];
+        x[i][ZZ] = status->x[3 * i + 2];
+    }
+    return 1;
+}
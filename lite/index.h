@@ -0,0 +1,16 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_LITE_INDEX_H
+#define GTA_LITE_INDEX_H
+
+#include "vec.h"
+
+void rd_index(const char *statfile, int ngrps, int isize[], atom_id *index[], char *grpnames[]);
+/* Lists the groups of the index file statfile and asks for ngrps of them on the standard input, by number or name, 
+ * like GROMACS's rd_index (see gmx_lite.c). The size, atoms and name of each selected group are stored in isize, index and grpnames.
+ * Memory is allocated for the arrays of index and grpnames.
+ */
+
+#endif // GTA_LITE_INDEX_H
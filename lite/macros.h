@@ -0,0 +1,10 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_LITE_MACROS_H
+#define GTA_LITE_MACROS_H
+
+#define asize(a) ((int)(sizeof(a) / sizeof((a)[0]))) // Number of elements of an array
+
+#endif // GTA_LITE_MACROS_H
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_LITE_PARGS_H
+#define GTA_LITE_PARGS_H
+
+#include "vec.h"
+
+/* Command line parsing like GROMACS's parse_common_args, for builds without GROMACS (see gmx_lite.c).
+ * Options are given as "-option value", and boolean options as "-option" or "-nooption".
+ * A file option without a file name selects the default file name. -h prints the description and options.
+ */
+
+typedef struct output_env *output_env_t; // Not used without GROMACS, always NULL
+
+// Types of the values of options
+enum {
+    etINT, etINT64, etREAL, etTIME, etSTR, etBOOL, etRVEC, etENUM, etNR
+};
+
+typedef struct {
+    const char *option;
+    gmx_bool bSet; // Whether the option was given
+    int type; // et*
+    union {
+        void *v; // for initialization
+        int *i;
+        real *r;
+        const char **c;
+        const char **enumc; // enumc[0] is set to the selected of the NULL-terminated choices after it
+        gmx_bool *b;
+        rvec *rv;
+    } u;
+    const char *desc;
+} t_pargs;
+
+// Types of files, which only set the description printed by -h
+enum {
+    efTRX, efTRR, efXTC, efNDX, efDAT, efXVG, efPDB, efGRO, efNR
+};
+
+#define ffSET 1 // The file option was given
+#define ffREAD 2
+#define ffWRITE 4
+#define ffOPT 8 // The file is optional, and only used if given
+#define ffRW (ffREAD | ffWRITE)
+#define ffOPTRD (ffREAD | ffOPT)
+#define ffOPTWR (ffWRITE | ffOPT)
+
+typedef struct {
+    int ftp; // ef*
+    const char *opt;
+    const char *fn; // File name, the default until the option is given
+    unsigned long flag; // ff*
+} t_filenm;
+
+gmx_bool parse_common_args(int *argc, char *argv[], unsigned long Flags, int nfile, t_filenm fnm[], int npargs, t_pargs *pa, 
+                           int ndesc, const char **desc, int nbugs, const char **bugs, output_env_t *oenv);
+/* Sets the files fnm and options pa from the command line and sets *oenv to NULL. 
+ * Exits after printing the description and options if -h is given, or with an error if an option is unknown or has no valid value.
+ * Flags are ignored.
+ */
+
+const char *opt2fn(const char *opt, int nfile, const t_filenm fnm[]);
+/* Returns the file name of the file option opt.
+ */
+
+const char *opt2fn_null(const char *opt, int nfile, const t_filenm fnm[]);
+/* Like opt2fn, but returns NULL for an optional file that was not given.
+ */
+
+gmx_bool opt2bSet(const char *opt, int nfile, const t_filenm fnm[]);
+/* Whether the file option opt was given.
+ */
+
+gmx_bool opt2parg_bSet(const char *option, int nparg, const t_pargs pa[]);
+/* Whether the option was given.
+ */
+
+#endif // GTA_LITE_PARGS_H
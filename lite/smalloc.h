@@ -0,0 +1,22 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_LITE_SMALLOC_H
+#define GTA_LITE_SMALLOC_H
+
+#include <stddef.h>
+
+/* Memory allocation like GROMACS's, which stops the program if memory runs out (see gmx_lite.c).
+ * snew allocates n zeroed elements, srenew resizes to n elements and sfree frees.
+ */
+
+#define snew(ptr, n) ((ptr) = save_calloc(#ptr, __FILE__, __LINE__, (n), sizeof(*(ptr))))
+#define srenew(ptr, n) ((ptr) = save_realloc(#ptr, __FILE__, __LINE__, (ptr), (n), sizeof(*(ptr))))
+#define sfree(ptr) save_free(#ptr, __FILE__, __LINE__, (ptr))
+
+void *save_calloc(const char *name, const char *file, int line, size_t n, size_t size);
+void *save_realloc(const char *name, const char *file, int line, void *ptr, size_t n, size_t size);
+void save_free(const char *name, const char *file, int line, void *ptr);
+
+#endif // GTA_LITE_SMALLOC_H
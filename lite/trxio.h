@@ -0,0 +1,29 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_LITE_TRXIO_H
+#define GTA_LITE_TRXIO_H
+
+#include "pargs.h"
+#include "vec.h"
+
+/* Trajectory reading like GROMACS's, for builds without GROMACS (see gmx_lite.c).
+ * Only XTC and TRR files can be read, with the readers of gta_xtc.h and gta_trr.h. Frames of TRR files without 
+ * coordinates are skipped. oenv is not used.
+ */
+
+typedef struct t_trxstatus t_trxstatus;
+
+int read_first_x(const output_env_t oenv, t_trxstatus **status, const char *fn, real *t, rvec **x, matrix box);
+/* Opens the trajectory fn and reads its first frame into *x, which is allocated, its time into *t and its box into box.
+ * Returns the number of atoms. Exits with an error if fn cannot be read.
+ */
+
+gmx_bool read_next_x(const output_env_t oenv, t_trxstatus *status, real *t, rvec x[], matrix box);
+/* Reads the next frame of the trajectory. Returns FALSE at its end.
+ */
+
+void close_trx(t_trxstatus *status);
+
+#endif // GTA_LITE_TRXIO_H
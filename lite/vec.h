@@ -0,0 +1,125 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#ifndef GTA_LITE_VEC_H
+#define GTA_LITE_VEC_H
+
+/* The basic types and vector operations of the GROMACS API used by g_tessla, for builds without GROMACS (see gmx_lite.c).
+ * Reals are in single precision unless GMX_DOUBLE is defined, as in GROMACS.
+ */
+
+#include <math.h>
+#include <stdio.h> // included by GROMACS's headers, which the code relies on
+#include <stdlib.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifdef GMX_DOUBLE
+typedef double real;
+#else
+typedef float real;
+#endif
+
+#define XX 0
+#define YY 1
+#define ZZ 2
+#define DIM 3
+
+typedef real rvec[DIM];
+typedef real matrix[DIM][DIM];
+typedef int atom_id;
+typedef int gmx_bool;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+static inline void rvec_sub(const rvec a, const rvec b, rvec c) {
+    c[XX] = a[XX] - b[XX];
+    c[YY] = a[YY] - b[YY];
+    c[ZZ] = a[ZZ] - b[ZZ];
+}
+
+static inline void rvec_inc(rvec a, const rvec b) {
+    a[XX] += b[XX];
+    a[YY] += b[YY];
+    a[ZZ] += b[ZZ];
+}
+
+static inline void copy_rvec(const rvec a, rvec b) {
+    b[XX] = a[XX];
+    b[YY] = a[YY];
+    b[ZZ] = a[ZZ];
+}
+
+static inline void clear_rvec(rvec a) {
+    a[XX] = a[YY] = a[ZZ] = 0;
+}
+
+static inline void svmul(real s, const rvec a, rvec b) {
+    b[XX] = s * a[XX];
+    b[YY] = s * a[YY];
+    b[ZZ] = s * a[ZZ];
+}
+
+static inline void cprod(const rvec a, const rvec b, rvec c) {
+    c[XX] = a[YY] * b[ZZ] - a[ZZ] * b[YY];
+    c[YY] = a[ZZ] * b[XX] - a[XX] * b[ZZ];
+    c[ZZ] = a[XX] * b[YY] - a[YY] * b[XX];
+}
+
+static inline real iprod(const rvec a, const rvec b) {
+    return a[XX] * b[XX] + a[YY] * b[YY] + a[ZZ] * b[ZZ];
+}
+
+static inline real norm2(const rvec a) {
+    return iprod(a, a);
+}
+
+static inline real norm(const rvec a) {
+    return sqrt(norm2(a));
+}
+
+static inline real distance2(const rvec a, const rvec b) {
+    rvec d;
+    rvec_sub(a, b, d);
+    return norm2(d);
+}
+
+static inline void unitv(const rvec a, rvec b) {
+    svmul(1 / norm(a), a, b);
+}
+
+static inline void clear_mat(matrix a) {
+    for(int i = 0; i < DIM; ++i) {
+        clear_rvec(a[i]);
+    }
+}
+
+static inline void copy_mat(matrix a, matrix b) {
+    for(int i = 0; i < DIM; ++i) {
+        copy_rvec(a[i], b[i]);
+    }
+}
+
+static inline void m_add(matrix a, matrix b, matrix dest) {
+    for(int i = 0; i < DIM; ++i) {
+        for(int j = 0; j < DIM; ++j) {
+            dest[i][j] = a[i][j] + b[i][j];
+        }
+    }
+}
+
+static inline void msmul(matrix a, real r, matrix dest) {
+    for(int i = 0; i < DIM; ++i) {
+        svmul(r, a[i], dest[i]);
+    }
+}
+
+#endif // GTA_LITE_VEC_H
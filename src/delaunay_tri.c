@@ -28,7 +28,6 @@
 #include <string.h>
 
 #define DTEPSILON 1e-12
-#define MINPOINTS 2
 
 
 struct vert {
@@ -98,6 +97,10 @@ static void ord_dtriangulate(struct vert *v,
 // Be warned.
 static void convertTrisFreeAdj(struct vert *v, struct dTriangulation *tri);
 
+static int compareEdges(const void *a, const void *b);
+
+static int locBucket(const struct dtLocator *loc, dtreal x, dtreal y);
+
 static inline int INDEX(const struct vert *v, struct dTriangulation *tri) {
     return (v->coord - tri->points) / 2;
 }
@@ -634,3 +637,185 @@ static void convertTrisFreeAdj(struct vert *v, struct dTriangulation *tri) {
     tri->ntriangles = ntri;
 }
 
+
+int dtedges(const struct dTriangulation *tri, uint64_t **edges) {
+    uint64_t *e = (uint64_t*)malloc((3 * tri->ntriangles + 1) * sizeof(uint64_t));
+    int n = 0;
+
+    for(int i = 0; i < tri->ntriangles; ++i) {
+        const int *t = &(tri->triangles[3*i]);
+        e[n++] = dtedge_key(t[0], t[1]);
+        e[n++] = dtedge_key(t[1], t[2]);
+        e[n++] = dtedge_key(t[2], t[0]);
+    }
+
+    qsort(e, n, sizeof(uint64_t), compareEdges);
+
+    // remove the duplicates of edges shared by two triangles
+    int nunique = 0;
+    for(int i = 0; i < n; ++i) {
+        if(nunique == 0 || e[i] != e[nunique-1]) {
+            e[nunique++] = e[i];
+        }
+    }
+
+    *edges = realloc(e, (nunique + 1) * sizeof(uint64_t)); // shrink memory if needed
+    return nunique;
+}
+
+static int compareEdges(const void *a, const void *b) {
+    uint64_t ea = *(const uint64_t*)a, eb = *(const uint64_t*)b;
+    return (ea > eb) - (ea < eb);
+}
+
+
+void dtlocinit(struct dtLocator *loc, const dtreal *points, const struct dTriangulation *tri) {
+    int ntri = tri->ntriangles;
+    loc->ntriangles = ntri;
+
+    // bounding box of the triangulated points
+    dtreal xmin = 0, ymin = 0, xmax = 0, ymax = 0;
+    int maxind = -1;
+    for(int i = 0; i < 3 * ntri; ++i) {
+        if(tri->triangles[i] > maxind)  maxind = tri->triangles[i];
+    }
+    loc->points = (dtreal*)malloc(2 * (maxind + 1) * sizeof(dtreal) + 1);
+    memcpy(loc->points, points, 2 * (maxind + 1) * sizeof(dtreal));
+    for(int i = 0; i <= maxind; ++i) {
+        dtreal x = points[2*i], y = points[2*i+1];
+        if(i == 0 || x < xmin)  xmin = x;
+        if(i == 0 || x > xmax)  xmax = x;
+        if(i == 0 || y < ymin)  ymin = y;
+        if(i == 0 || y > ymax)  ymax = y;
+    }
+
+    // copy the triangles in counterclockwise order
+    loc->triangles = (int*)malloc((3 * ntri + 1) * sizeof(int));
+    for(int i = 0; i < ntri; ++i) {
+        int *t = &(loc->triangles[3*i]);
+        t[0] = tri->triangles[3*i];
+        t[1] = tri->triangles[3*i+1];
+        t[2] = tri->triangles[3*i+2];
+        if(orient2d(&loc->points[2*t[0]], &loc->points[2*t[1]], &loc->points[2*t[2]]) < 0) {
+            int tmp = t[1];
+            t[1] = t[2];
+            t[2] = tmp;
+        }
+    }
+
+    // find the neighbours across each edge by sorting the edges of all triangles by key, 
+    // with the triangle and edge number in the low bits of a second key
+    uint64_t (*e)[2] = malloc((3 * ntri + 1) * sizeof(*e));
+    for(int i = 0; i < ntri; ++i) {
+        const int *t = &(loc->triangles[3*i]);
+        for(int j = 0; j < 3; ++j) {
+            e[3*i+j][0] = dtedge_key(t[j], t[(j+1) % 3]);
+            e[3*i+j][1] = 3*i+j;
+        }
+    }
+    qsort(e, 3 * ntri, sizeof(*e), compareEdges); // sorts by the first key only
+
+    loc->neighbours = (int*)malloc((3 * ntri + 1) * sizeof(int));
+    for(int i = 0; i < 3 * ntri; ++i) {
+        loc->neighbours[i] = -1;
+    }
+    for(int i = 0; i + 1 < 3 * ntri; ++i) {
+        if(e[i][0] == e[i+1][0]) { // edge shared by two triangles
+            loc->neighbours[e[i][1]] = e[i+1][1] / 3;
+            loc->neighbours[e[i+1][1]] = e[i][1] / 3;
+            ++i;
+        }
+    }
+    free(e);
+
+    // bucket grid with about two triangles per bucket
+    dtreal w = xmax - xmin, h = ymax - ymin;
+    int nb = ntri / 2 > 1 ? ntri / 2 : 1;
+    loc->cell = (w > 0 && h > 0) ? sqrt(w * h / nb) : (w > h ? w : h) / nb;
+    if(loc->cell <= 0)  loc->cell = 1;
+    loc->xmin = xmin;
+    loc->ymin = ymin;
+    loc->nx = (int)(w / loc->cell) + 1;
+    loc->ny = (int)(h / loc->cell) + 1;
+
+    loc->buckets = (int*)malloc(loc->nx * loc->ny * sizeof(int));
+    for(int i = 0; i < loc->nx * loc->ny; ++i) {
+        loc->buckets[i] = -1;
+    }
+    for(int i = 0; i < ntri; ++i) { // bucket each triangle by its centroid
+        const int *t = &(loc->triangles[3*i]);
+        dtreal cx = (loc->points[2*t[0]] + loc->points[2*t[1]] + loc->points[2*t[2]]) / 3;
+        dtreal cy = (loc->points[2*t[0]+1] + loc->points[2*t[1]+1] + loc->points[2*t[2]+1]) / 3;
+        loc->buckets[locBucket(loc, cx, cy)] = i;
+    }
+    // empty buckets start from the triangle of the previous bucket
+    int last = ntri > 0 ? 0 : -1;
+    for(int i = 0; i < loc->nx * loc->ny; ++i) {
+        if(loc->buckets[i] < 0)     loc->buckets[i] = last;
+        else                        last = loc->buckets[i];
+    }
+}
+
+int dtlocate(const struct dtLocator *loc, dtreal x, dtreal y, int hint, dtreal *bary) {
+    if(loc->ntriangles == 0)    return -1;
+
+    dtreal q[2] = {x, y};
+    int t = hint >= 0 ? hint : loc->buckets[locBucket(loc, x, y)];
+
+    // Visibility walk: step across any edge that q is to the right of until it is to the right of none.
+    // This terminates for delaunay triangulations, but the number of steps is capped as a safeguard.
+    for(int step = 0; step <= loc->ntriangles; ++step) {
+        const int *v = &(loc->triangles[3*t]);
+        int next = t;
+
+        for(int j = 0; j < 3; ++j) {
+            if(orient2d(&loc->points[2*v[j]], &loc->points[2*v[(j+1) % 3]], q) < 0) {
+                next = loc->neighbours[3*t+j];
+                if(next < 0)    return -1; // outside of the convex hull
+                break;
+            }
+        }
+
+        if(next == t) { // found
+            if(bary) {
+                dtreal *a = &loc->points[2*v[0]], *b = &loc->points[2*v[1]], *c = &loc->points[2*v[2]];
+                dtreal area = orient2d(a, b, c);
+                bary[0] = orient2d(b, c, q) / area;
+                bary[1] = orient2d(c, a, q) / area;
+                bary[2] = 1 - bary[0] - bary[1];
+            }
+            return t;
+        }
+        t = next;
+    }
+
+    return -1;
+}
+
+void dtlocateall(const struct dtLocator *loc, const dtreal *q, int nq, int *tris, dtreal *bary) {
+    int prev_bucket = -1, prev_tri = -1, bucket;
+
+    for(int i = 0; i < nq; ++i) {
+        bucket = locBucket(loc, q[2*i], q[2*i+1]);
+        tris[i] = dtlocate(loc, q[2*i], q[2*i+1], bucket == prev_bucket ? prev_tri : -1, bary ? &bary[3*i] : NULL);
+        prev_bucket = bucket;
+        prev_tri = tris[i];
+    }
+}
+
+void dtlocfree(struct dtLocator *loc) {
+    free(loc->points);
+    free(loc->triangles);
+    free(loc->neighbours);
+    free(loc->buckets);
+}
+
+static int locBucket(const struct dtLocator *loc, dtreal x, dtreal y) {
+    int bx = (int)((x - loc->xmin) / loc->cell);
+    int by = (int)((y - loc->ymin) / loc->cell);
+    if(bx < 0)          bx = 0;
+    if(bx >= loc->nx)   bx = loc->nx - 1;
+    if(by < 0)          by = 0;
+    if(by >= loc->ny)   by = loc->ny - 1;
+    return bx * loc->ny + by;
+}
@@ -22,7 +22,8 @@
 
 #define CORR_EPS 1e-12
 
-enum {efT_TRAJ, efT_NDX, efT_OUTDAT, efT_NUMFILES};
+enum {efT_TRAJ, efT_NDX, efT_OUTDAT, efT_PRINT, efT_PLY, efT_AAREA, efT_AMAP, efT_APSI6, efT_ACURV, efT_DOMAINS, 
+      efT_THICK, efT_HIST, efT_RAW, efT_CPT, efT_NUMFILES};
 
 int main(int argc, char *argv[]) {
 #ifdef GTA_BENCH
@@ -33,6 +34,23 @@ int main(int argc, char *argv[]) {
         "g_tessla calculates 3-d surface area using Delaunay tessellation. \n",
         "It reads in a trajectory file through the -f option (supported formats=xtc,trr,pdb). \n",
         "The set of points for tessellation, such as the coordinates of phosphorous atoms in a lipid bilayer, are specified using an index file by the -n option.\n",
+        "Several index groups, such as the two leaflets of a bilayer, can be tessellated separately in a single pass over the trajectory ",
+        "by setting -ng X, where X is the number of groups to select.\n",
+        "With the -leaflets option, each group is split into its upper and lower leaflets every frame ",
+        "by the z-coordinates of its atoms relative to the bilayer centre, and both leaflets are tessellated. \n",
+        "The frames to read can be limited to a time range with -b and -e, and thinned with -dt (in ps) or -skip (every nr-th frame). ",
+        "Frames of XTC files outside of the selection are not decompressed.\n",
+        "With -raw, the selected atoms of the frames read are also saved to a raw binary file of single precision coordinates. ",
+        "Later runs given the same -raw file map it into memory instead of reading the trajectory, ",
+        "as long as the trajectory has not changed and the file holds the selected atoms and frames.\n",
+        "With -follow, g_tessla follows an XTC file that a running simulation is still writing: ",
+        "new frames are tessellated as they are added and their areas appended to the -o file, which is written out every -flush frames, ",
+        "until no frame has been added for -wait seconds. The outputs that need every frame (-print, -ply, -tol, maps, histograms, ",
+        "-nb, -domains and per-atom files) cannot be used with -follow, and -b, -e, -dt, -skip and -raw do not apply.\n",
+        "With -cpt, the areas of the finished frames are saved to a checkpoint file every -cptint minutes ",
+        "and at the end. If the run is interrupted, running it again with the same options and -cpt file skips the frames that were finished, ",
+        "with any number of threads, and gives the same output as an uninterrupted run. ",
+        "Like -follow, -cpt can only be used with the areas, -psi6, -curv and -ntypes.\n",
         "Areas can be calculated individually for each frame in which case the output is dumped into an ASCII file specified by the -o option.\n\n",
         "This code can also be used for calculating the surface areas of lipid bilayers.\n", 
         "In such a calculation, the lipid bilayer normal is assumed to be parallel to the z-axis.\n",
@@ -47,12 +65,41 @@ int main(int argc, char *argv[]) {
         "An alternative way to calculate lipid surface areas is to map the coordinates onto a weighted 3D grid \n", 
         "and tessellate the highest weight z-coordinates along the horizontal plane.\n",
         "The latter method is, however, still experimental and not supported. \n",
-        "To use the experimental weighted grid method, set the -dense option.\n\n",       
-        "The tessellated surface can be visualized using the -print option. The resulting .node and .ele files are numbered by frame \n",
-        "and can be viewed by Jonathan R. Shewchuck's program showme\n",
-        "(found here: https://www.cs.cmu.edu/~quake/showme.html)\n",
-        "WARNING, the -print option produces a .node and .ele file for EVERY frame AND disables parallelization!\n",
-        "(So don't be surprised when you come back hours later and see a hundred thousand new files in your current directory)\n\n",
+        "To use the experimental weighted grid method, set the -dense option.\n",
+        "With -pack X, the frames are kept in memory as integers in units of 1/X nm, as in XTC files, ",
+        "compressed as differences between frames, for long trajectories that do not otherwise fit in memory.\n\n",       
+        "The tessellated surfaces of every frame can be saved to a single binary file using the -print option.\n",
+        "Its format is described in gta_io.h; the points and triangles of any frame can be found through the offset table at its end.\n",
+        "The surfaces can also be saved as a 3D mesh in binary PLY format for rendering using the -ply option.\n",
+        "Each vertex carries the number of its frame and surface so that frames can be picked out in the viewer.\n\n",
+        "The area of each triangle can be split evenly between its atoms, and the resulting area of every atom in every frame ",
+        "saved to a binary file using the -aarea option (format described in gta_io.h).\n",
+        "With -ntypes X, another X index groups are selected as lipid types, and the average area per atom of each type ",
+        "is written to the output file for every frame.\n\n",
+        "The mean, variance, standard error and autocorrelation time of the areas are logged at the end. ",
+        "The standard error is found by block averaging, so it accounts for the correlation between frames. ",
+        "The area compressibility modulus is calculated from the fluctuations of the box area at the temperature given by -temp.\n",
+        "With -tol X, frames are tessellated in strided order (or random order with -shuffle) until the standard error ",
+        "of the mean area per particle is below X, and only the tessellated frames are written to the output file. ",
+        "The coordinates of XTC frames are then only decoded for the frames tessellated.\n\n",
+        "The -amap option saves a time-averaged map of the area per particle over the xy-plane, ",
+        "eg around a membrane protein, with -mapbins X bins along each box vector. ",
+        "The area of each triangle is split between its atoms, which are binned by position every frame.\n",
+        "The -hist option saves the distributions of the areas of triangles and lengths of Delaunay edges between atoms ",
+        "over all frames, with -hbins bins up to -hamax and -hlmax.\n",
+        "With -nb, the average coordination number (number of delaunay neighbours) of each surface and the fraction ",
+        "of the neighbour pairs of the previous frame that were exchanged are written to the output file for every frame.\n",
+        "With -psi6, the average magnitude of the hexatic order parameter psi6 of the atoms, ",
+        "found from the angles of their delaunay edges in the xy-plane, is written to the output file for every frame. ",
+        "The real and imaginary parts of psi6 of every atom in every frame can be saved to a binary file with -apsi6.\n",
+        "With -curv, the discrete mean curvature (cotangent Laplacian) and gaussian curvature (angle deficit) of the triangulated surfaces ",
+        "averaged over their atoms are written to the output file for every frame. ",
+        "The normal and curvatures of every atom in every frame can be saved to a binary file with -acurv.\n",
+        "With -ntypes, the -domains option clusters the atoms of each lipid type that are joined by delaunay edges into domains. ",
+        "The number of domains and the size and area of the largest domain of each type are written to the output file for every frame, ",
+        "and the average number of domains of each size per frame to the -domains file.\n",
+        "With -leaflets, the -thick option saves a time-averaged map of the bilayer thickness, ",
+        "found by interpolating the heights of the triangulated leaflets at the -mapbins grid nodes every frame.\n\n",
         "If you build g_tessla with OPENMP, you can set the number of threads to use with -nthreads X,\n",
         "where X is the number of threads to use. The default is to use the maximum number of cores available.\n"
     };
@@ -61,31 +108,83 @@ int main(int argc, char *argv[]) {
     output_env_t oenv = NULL;
 
     int nthreads = -1;
+    int ngroups = 1;
+    struct frame_range range = {-1, -1, 0, 1};
+    gmx_bool follow = FALSE;
+    real wait = 60;
+    int nflush = 1;
+    real cpt_period = 15;
+    gmx_bool leaflets = FALSE;
     gmx_bool dense = FALSE;
     gmx_bool corr = FALSE;
     real espace = 0.8;
     gmx_bool a2D = FALSE;
-    gmx_bool print = FALSE;
     real cell_width = 0.1;
+    real pack = 0;
     gmx_bool linear = FALSE;
+    int ntypes = 0;
+    real temp = 300;
+    real tol = 0;
+    gmx_bool shuffle = FALSE;
+    int seed = 1993;
+    int map_bins = 50;
+    gmx_bool neighbours = FALSE;
+    gmx_bool psi6 = FALSE;
+    gmx_bool curv = FALSE;
+    int hist_bins = 100;
+    real hist_area_max = 1.5;
+    real hist_edge_max = 2.0;
 
     init_log("gta.log", argc, argv);
 
     t_filenm fnm[] = {
         {efTRX, "-f", "traj.xtc", ffREAD},
         {efNDX, "-n", "index.ndx", ffOPTRD},
-        {efDAT, "-o", "tessellated_areas.dat", ffWRITE}
+        {efDAT, "-o", "tessellated_areas.dat", ffWRITE},
+        {efDAT, "-print", "triangles.dat", ffOPTWR},
+        {efDAT, "-ply", "surfaces.ply", ffOPTWR},
+        {efDAT, "-aarea", "atom_areas.dat", ffOPTWR},
+        {efDAT, "-amap", "area_map.dat", ffOPTWR},
+        {efDAT, "-apsi6", "atom_psi6.dat", ffOPTWR},
+        {efDAT, "-acurv", "atom_curvatures.dat", ffOPTWR},
+        {efDAT, "-domains", "domain_sizes.dat", ffOPTWR},
+        {efDAT, "-thick", "thickness_map.dat", ffOPTWR},
+        {efDAT, "-hist", "histograms.dat", ffOPTWR},
+        {efDAT, "-raw", "frames.raw", ffOPTWR},
+        {efDAT, "-cpt", "state.cpt", ffOPTWR}
     };
 
     t_pargs pa[] = {
         {"-nthreads", FALSE, etINT, {&nthreads}, "set the number of parallel threads to use (default is max available)"}, 
+        {"-ng", FALSE, etINT, {&ngroups}, "number of index groups to tessellate separately"}, 
+        {"-b", FALSE, etREAL, {&range.begin}, "time of the first frame to read (ps, -1 for the first frame)"}, 
+        {"-e", FALSE, etREAL, {&range.end}, "time of the last frame to read (ps, -1 for the last frame)"}, 
+        {"-dt", FALSE, etREAL, {&range.dt}, "only read frames at multiples of this time after the first frame (ps, 0 for every frame)"}, 
+        {"-skip", FALSE, etINT, {&range.stride}, "only read every nr-th frame of those between -b and -e"}, 
+        {"-follow", FALSE, etBOOL, {&follow}, "follow an XTC file that is still being written, tessellating frames as they are added"}, 
+        {"-wait", FALSE, etREAL, {&wait}, "with -follow, stop once no frame has been added for this long (s)"}, 
+        {"-flush", FALSE, etINT, {&nflush}, "with -follow, write the output file out every nr frames"}, 
+        {"-cptint", FALSE, etREAL, {&cpt_period}, "minutes between checkpoints if using -cpt"}, 
+        {"-leaflets", FALSE, etBOOL, {&leaflets}, "split each group into upper and lower leaflets every frame and tessellate both"}, 
         {"-dense", FALSE, etBOOL, {&dense}, "use weighted-grid tessellation instead of frame-by-frame delaunay triangulation"},
         {"-corr", FALSE, etBOOL, {&corr}, "correct triangulation area for periodic bounding"},
         {"-espace", FALSE, etREAL, {&espace}, "the spacing of the edge correction point intervals if using -corr (default = 0.8)"},
         {"-2d", FALSE, etBOOL, {&a2D}, "calculate 2D surface area from delaunay triangulation"},
-        {"-print", FALSE, etBOOL, {&print}, "BE CAREFUL (see readme); save delaunay triangles to .node and .ele files"},
+        {"-ntypes", FALSE, etINT, {&ntypes}, "number of further index groups to select as lipid types for per-type areas"},
+        {"-temp", FALSE, etREAL, {&temp}, "temperature (K) for the area compressibility modulus, 0 for none"},
+        {"-tol", FALSE, etREAL, {&tol}, "stop once the standard error of the area per particle is below this (0 tessellates all frames)"},
+        {"-shuffle", FALSE, etBOOL, {&shuffle}, "tessellate frames in random instead of strided order if using -tol"},
+        {"-seed", FALSE, etINT, {&seed}, "random seed for -shuffle"},
+        {"-nb", FALSE, etBOOL, {&neighbours}, "calculate coordination numbers and neighbour exchange between frames from the delaunay edges"},
+        {"-psi6", FALSE, etBOOL, {&psi6}, "calculate the hexatic order parameter from the delaunay edges"},
+        {"-curv", FALSE, etBOOL, {&curv}, "calculate the mean and gaussian curvatures of the triangulated surfaces"},
+        {"-mapbins", FALSE, etINT, {&map_bins}, "number of bins along each box vector of the -amap and -thick maps"},
+        {"-hbins", FALSE, etINT, {&hist_bins}, "number of bins of the -hist distributions"},
+        {"-hamax", FALSE, etREAL, {&hist_area_max}, "largest triangle area (nm^2) in the -hist distributions"},
+        {"-hlmax", FALSE, etREAL, {&hist_edge_max}, "largest edge length (nm) in the -hist distributions"},
         {"-width", FALSE, etREAL, {&cell_width}, "width of each grid cell if using -dense"},
-        {"-lin", FALSE, etBOOL, {&linear}, "use distance instead of distance squared for weighing if using -dense"}
+        {"-lin", FALSE, etBOOL, {&linear}, "use distance instead of distance squared for weighing if using -dense"},
+        {"-pack", FALSE, etREAL, {&pack}, "keep the frames compressed in memory with this precision (per nm) if using -dense, 0 for none"}
     };
 
     parse_common_args(&argc, argv, 0, efT_NUMFILES, fnm, asize(pa), pa, asize(desc), desc, 0, NULL, &oenv);
@@ -93,12 +192,23 @@ int main(int argc, char *argv[]) {
     fnames[efT_TRAJ] = opt2fn("-f", efT_NUMFILES, fnm);
     fnames[efT_NDX] = opt2fn_null("-n", efT_NUMFILES, fnm);
     fnames[efT_OUTDAT] = opt2fn("-o", efT_NUMFILES, fnm);
+    fnames[efT_PRINT] = opt2fn_null("-print", efT_NUMFILES, fnm);
+    fnames[efT_PLY] = opt2fn_null("-ply", efT_NUMFILES, fnm);
+    fnames[efT_AAREA] = opt2fn_null("-aarea", efT_NUMFILES, fnm);
+    fnames[efT_AMAP] = opt2fn_null("-amap", efT_NUMFILES, fnm);
+    fnames[efT_APSI6] = opt2fn_null("-apsi6", efT_NUMFILES, fnm);
+    fnames[efT_ACURV] = opt2fn_null("-acurv", efT_NUMFILES, fnm);
+    fnames[efT_DOMAINS] = opt2fn_null("-domains", efT_NUMFILES, fnm);
+    fnames[efT_THICK] = opt2fn_null("-thick", efT_NUMFILES, fnm);
+    fnames[efT_HIST] = opt2fn_null("-hist", efT_NUMFILES, fnm);
+    fnames[efT_RAW] = opt2fn_null("-raw", efT_NUMFILES, fnm);
+    fnames[efT_CPT] = opt2fn_null("-cpt", efT_NUMFILES, fnm);
 
     if(dense) {
         real (*fweight)(rvec, rvec) = linear ? weight_dist : weight_dist2;
         struct tessellated_grid grid;
 
-        gta_grid_area(fnames[efT_TRAJ], fnames[efT_NDX], cell_width, fweight, &oenv, &grid);
+        gta_grid_area(fnames[efT_TRAJ], fnames[efT_NDX], &range, fnames[efT_RAW], pack, cell_width, fweight, &oenv, &grid);
 
         if(grid.num_empty > 0) {
             print_log("\n\nWARNING: %d grid cell(s) have empty corner(s).\n"
@@ -113,19 +223,65 @@ int main(int argc, char *argv[]) {
         free_grid(&grid);
     }
     else {
-        if(print)   nthreads = 1;
-
-        struct tri_area areas;
+        int nsurf = leaflets ? 2 : 1; // Number of surfaces per group
+        struct tri_area *areas;
+        snew(areas, nsurf * ngroups);
 
         unsigned long flags = ((int)corr * GTA_CORRECT) 
                             | ((int)a2D * GTA_2D) 
-                            | ((int)print * GTA_PRINT);
+                            | ((fnames[efT_PRINT] != NULL) * GTA_PRINT) 
+                            | ((int)leaflets * GTA_LEAFLETS) 
+                            | ((fnames[efT_PLY] != NULL) * GTA_PLY) 
+                            | ((fnames[efT_AAREA] != NULL) * GTA_ATOMAREA) 
+                            | ((tol > 0) * GTA_ESTOP) 
+                            | ((fnames[efT_AMAP] != NULL) * GTA_AREAMAP) 
+                            | ((fnames[efT_HIST] != NULL) * GTA_HIST) 
+                            | ((fnames[efT_THICK] != NULL) * GTA_THICKNESS) 
+                            | ((int)neighbours * GTA_NEIGHBOURS) 
+                            | ((psi6 || fnames[efT_APSI6] != NULL) * GTA_PSI6) 
+                            | ((fnames[efT_APSI6] != NULL) * GTA_ATOMPSI6) 
+                            | ((fnames[efT_DOMAINS] != NULL) * GTA_DOMAINS) 
+                            | ((curv || fnames[efT_ACURV] != NULL) * GTA_CURVATURE) 
+                            | ((fnames[efT_ACURV] != NULL) * GTA_ATOMCURV) 
+                            | ((fnames[efT_CPT] != NULL) * GTA_CHECKPOINT);
+        
+        struct tri_output out;
+        out.dump_fname = fnames[efT_PRINT];
+        out.ply_fname = fnames[efT_PLY];
+        out.atom_area_fname = fnames[efT_AAREA];
+        out.atom_psi6_fname = fnames[efT_APSI6];
+        out.atom_curv_fname = fnames[efT_ACURV];
+        out.ntypes = ntypes;
+        out.types = NULL;
+        out.temp = temp;
+        out.tol = tol;
+        out.order = shuffle ? GTA_ORDER_RANDOM : GTA_ORDER_STRIDED;
+        out.seed = seed;
+        out.map_bins = map_bins;
+        out.hist_bins = hist_bins;
+        out.hist_area_max = hist_area_max;
+        out.hist_edge_max = hist_edge_max;
+        out.cpt_fname = fnames[efT_CPT];
+        out.cpt_period = cpt_period;
         
-        tessellate_area(fnames[efT_TRAJ], fnames[efT_NDX], &oenv, espace, nthreads, &areas, flags);
+        if(follow) {
+            follow_area(fnames[efT_TRAJ], fnames[efT_NDX], ngroups, fnames[efT_OUTDAT], wait, nflush, 
+                espace, nthreads, areas, &out, flags);
+        }
+        else {
+            tessellate_area(fnames[efT_TRAJ], fnames[efT_NDX], ngroups, &range, fnames[efT_RAW], &oenv, espace, nthreads, areas, &out, flags);
 
-        print_areas(fnames[efT_OUTDAT], &areas);
+            print_areas(fnames[efT_OUTDAT], ngroups, areas);
+        }
+        if(fnames[efT_AMAP])  print_area_map(fnames[efT_AMAP], ngroups, areas);
+        if(fnames[efT_HIST])  print_histograms(fnames[efT_HIST], ngroups, areas);
+        if(fnames[efT_THICK]) print_thickness_map(fnames[efT_THICK], ngroups, areas);
+        if(fnames[efT_DOMAINS])   print_domain_sizes(fnames[efT_DOMAINS], ngroups, areas);
 
-        free_tri_area(&areas);
+        for(int i = 0; i < nsurf * ngroups; ++i) {
+            free_tri_area(&areas[i]);
+        }
+        sfree(areas);
     }
 
 #ifdef GTA_BENCH
@@ -0,0 +1,1036 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ *
+ * This program uses the GROMACS molecular simulation package API.
+ * Copyright (c) 1991-2000, University of Groningen, The Netherlands.
+ * Copyright (c) 2001-2004, The GROMACS development team.
+ * Copyright (c) 2013,2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed at http://www.gromacs.org.
+ */
+
+#define _GNU_SOURCE // for posix_memalign and madvise
+#define _FILE_OFFSET_BITS 64 // for seeking in files over 2 GB
+
+#include "gta_frames.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef GRO_V5
+#include "trxio.h"
+#endif
+#include "gkut_io.h"
+#include "gkut_log.h"
+#include "gmx_fatal.h"
+#include "gta_xtc.h"
+#include "smalloc.h"
+
+#define FRAMES_HUGEPAGE (2 << 20) // Size of a transparent huge page, the alignment of blocks that can use them
+#define RAW_HEADER 72 // Size of the fixed part of the header of raw trajectory files in bytes
+#define RAW_PAGE 4096 // Alignment of the frames in raw trajectory files, so that they can be mapped
+#define PACK_CHUNK (64 << 20) // Bytes of frames read at a time before they are packed
+#define FOLLOW_POLL 0.2 // Seconds between checks of a followed file for new frames
+
+// Frames of an XTC file decoded by frames_load
+struct frames_source {
+    char *fname;
+    struct xtc_index index;
+    int *fr_sel; // Frame of the file of each frame of the store
+    atom_id *sel; // Indexes of the selected atoms, or NULL for all
+    unsigned char *decoded; // Whether each frame of the store has been decoded
+};
+
+static real *alloc_frames(size_t nreals);
+/* Allocates an aligned block of nreals reals, backed by huge pages if it is large enough and they are available.
+ */
+
+static int is_xtc(const char *fname);
+/* Whether fname has the extension of an XTC file.
+ */
+
+static int select_atoms(int numgroups, atom_id **indx, const int *isize, atom_id **sel);
+/* Sets *sel to the indexes of the atoms of numgroups groups in indx, one group after another, and returns their number.
+ * If indx is NULL, *sel is NULL and 0 is returned. Memory is allocated for *sel.
+ */
+
+static void check_atoms(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, int natoms);
+/* Exits with an error if an atom of the groups in indx is not among the natoms atoms of traj_fname.
+ */
+
+static int select_xtc_frames(const char *traj_fname, const struct xtc_index *index, const struct frame_range *range, int **fr_sel);
+/* Sets *fr_sel to the frames in range of the XTC file traj_fname found in index, and returns their number.
+ * Exits with an error if there are none. Memory is allocated for *fr_sel.
+ */
+
+static void decode_xtc(const char *traj_fname, const struct xtc_index *index, const int *fr_sel, const int *slots, int nfr_sel, 
+                       const atom_id *sel, const struct gta_frames *frames);
+/* Decodes the nfr_sel frames fr_sel of the XTC file traj_fname found in index into frames, keeping the atoms sel (or all if NULL).
+ * Frame fr_sel[k] is stored as frame slots[k] of frames, or frame k if slots is NULL, whose planes, box and time must exist.
+ * Each thread opens the file and decodes a contiguous range of frames with its own decoder.
+ */
+
+static int compare_ints(const void *a, const void *b);
+/* Orders ints for qsort.
+ */
+
+static void read_chunks(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, const struct frame_range *range,
+                        const char *raw_fname, size_t chunk_size, void (*flush)(struct gta_frames *, void *), void *arg, 
+                        struct gta_frames *frames, int *natoms, output_env_t *oenv);
+/* Reads the frames in range like read_frames. If flush is not NULL, frames holds about chunk_size bytes of frames 
+ * (whole blocks of PACK_BLOCK frames) at a time: whenever it is full, and after the last frame, flush(frames, arg) 
+ * is called and frames is emptied. raw_fname is then not written to, but still read from if it holds the frames.
+ */
+
+static void pack_block(const struct gta_frames *frames, int first, int nframes, real precision, struct packed_block *block);
+/* Compresses nframes frames of frames from first into block.
+ */
+
+static void pack_chunk(struct gta_frames *frames, void *packed);
+/* Flush function of read_chunks that adds the frames read to a packed frame store.
+ */
+
+static int follow_frame(struct frames_follower *fl, float *time, float box[3][3]);
+/* Reads the next frame of a followed file into fl->x if all of it has been written. 
+ * Returns 1 if it was read, and otherwise 0, leaving the file at the start of the frame to try again later.
+ * Exits with an error if the frame is corrupt.
+ */
+
+static void pause_follow(void);
+/* Sleeps for FOLLOW_POLL seconds.
+ */
+
+static int source_stamp(const char *fname, int64_t stamp[3]);
+/* Stores the size, modification time (s) and nanoseconds of the modification time of fname in stamp.
+ */
+
+static void raw_range(const struct frame_range *range, float r[3], int32_t *skip);
+/* The begin, end, dt and stride of range as stored in raw trajectory files, with every frame always stored the same way.
+ */
+
+static int map_raw(const char *raw_fname, const char *traj_fname, const atom_id *sel, int nsel, 
+                   const struct frame_range *range, struct gta_frames *frames, int *natoms);
+/* Takes the frames in range of the nsel atoms sel (or all atoms of the source if NULL) from the raw trajectory raw_fname 
+ * (see gta_frames.h), setting *natoms to the number of atoms of its source. 
+ * Returns -1 if raw_fname cannot be used: it cannot be read, was not made from traj_fname as it is now, 
+ * was made with another range that did not include every frame or lacks any of the atoms.
+ */
+
+static int write_raw(const char *raw_fname, const char *traj_fname, const atom_id *sel, int source_natoms, 
+                     const struct frame_range *range, const struct gta_frames *frames);
+/* Saves frames, holding the atoms sel (or all atoms if NULL) of traj_fname in range, to the raw trajectory file raw_fname.
+ */
+
+
+void frames_init(struct gta_frames *frames, int natoms, int capacity) {
+    size_t per_line = FRAMES_ALIGN / sizeof(real);
+
+    frames->natoms = natoms;
+    frames->nframes = 0;
+    frames->stride = (natoms + per_line - 1) / per_line * per_line;
+    frames->capacity = capacity > 0 ? capacity : 1;
+    frames->data = alloc_frames(3 * frames->capacity * frames->stride);
+    snew(frames->box, frames->capacity);
+    snew(frames->time, frames->capacity);
+    frames->map = NULL;
+    frames->map_size = 0;
+    frames->source = NULL;
+}
+
+
+void frames_append(struct gta_frames *frames, const rvec *x, const atom_id *indx, matrix box, real t) {
+    if(frames->nframes >= frames->capacity) { // double the capacity, copying the frames into a new block
+        int capacity = 2 * frames->capacity;
+        real *data = alloc_frames(3 * capacity * frames->stride);
+        memcpy(data, frames->data, 3 * frames->nframes * frames->stride * sizeof(real));
+        free(frames->data);
+        frames->data = data;
+        frames->capacity = capacity;
+        srenew(frames->box, capacity);
+        srenew(frames->time, capacity);
+    }
+
+    int fr = frames->nframes, natoms = frames->natoms;
+    real *px = frames->data + 3 * fr * frames->stride;
+    real *py = px + frames->stride, *pz = py + frames->stride;
+
+    for(int i = 0; i < natoms; ++i) {
+        const real *xi = x[indx ? indx[i] : i];
+        px[i] = xi[XX];
+        py[i] = xi[YY];
+        pz[i] = xi[ZZ];
+    }
+    copy_mat(box, frames->box[fr]);
+    frames->time[fr] = t;
+
+    ++frames->nframes;
+}
+
+
+void frames_get(const struct gta_frames *frames, int fr, rvec *x) {
+    const real *px = frames_x(frames, fr), *py = frames_y(frames, fr), *pz = frames_z(frames, fr);
+
+    for(int i = 0; i < frames->natoms; ++i) {
+        x[i][XX] = px[i];
+        x[i][YY] = py[i];
+        x[i][ZZ] = pz[i];
+    }
+}
+
+
+void read_frames(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, const struct frame_range *range,
+    const char *raw_fname, struct gta_frames *frames, int *natoms, output_env_t *oenv) {
+    read_chunks(traj_fname, numgroups, indx, isize, range, raw_fname, 0, NULL, NULL, frames, natoms, oenv);
+}
+
+
+void read_frames_lazy(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, const struct frame_range *range,
+    const char *raw_fname, struct gta_frames *frames, int *natoms, output_env_t *oenv) {
+    struct xtc_index index;
+    int cached = 0;
+
+    if(raw_fname || !is_xtc(traj_fname) || xtc_cached_index(traj_fname, &index, &cached) != 0) {
+        read_frames(traj_fname, numgroups, indx, isize, range, raw_fname, frames, natoms, oenv);
+        return;
+    }
+    *natoms = index.natoms;
+    print_log("%s %d frames of %d atoms in %s.\n", cached ? "Loaded the index of" : "Found", 
+        index.nframes, index.natoms, traj_fname);
+    check_atoms(traj_fname, numgroups, indx, isize, *natoms);
+
+    struct frames_source *src;
+    snew(src, 1);
+    int nsel = select_atoms(numgroups, indx, isize, &src->sel);
+    if(indx == NULL)    nsel = *natoms;
+    int nfr_sel = select_xtc_frames(traj_fname, &index, range, &src->fr_sel);
+    src->index = index;
+    snew(src->fname, strlen(traj_fname) + 1);
+    strcpy(src->fname, traj_fname);
+    snew(src->decoded, nfr_sel);
+
+    frames_init(frames, nsel, nfr_sel);
+    frames->nframes = nfr_sel;
+    for(int k = 0; k < nfr_sel; ++k) {
+        int fr = src->fr_sel[k];
+        for(int d = 0; d < DIM; ++d) {
+            for(int e = 0; e < DIM; ++e) {
+                frames->box[k][d][e] = index.boxes[fr][d][e];
+            }
+        }
+        frames->time[k] = index.times[fr];
+    }
+    frames->source = src;
+    print_log("Selected %d of %d frames of %s, to be decoded as they are needed.\n", nfr_sel, index.nframes, traj_fname);
+}
+
+
+void frames_load(const struct gta_frames *frames, const int *frs, int n) {
+    struct frames_source *src = frames->source;
+    int *slots, *fr_sel, m = 0;
+
+    if(src == NULL)     return;
+    snew(slots, n);
+    snew(fr_sel, n);
+    for(int k = 0; k < n; ++k) {
+        if(!src->decoded[frs[k]]) {
+            src->decoded[frs[k]] = 1;
+            slots[m++] = frs[k];
+        }
+    }
+    qsort(slots, m, sizeof(int), compare_ints); // in file order, so that each thread reads forward
+    for(int k = 0; k < m; ++k) {
+        fr_sel[k] = src->fr_sel[slots[k]];
+    }
+    if(m > 0) {
+        decode_xtc(src->fname, &src->index, fr_sel, slots, m, src->sel, frames);
+    }
+    sfree(slots);
+    sfree(fr_sel);
+}
+
+
+static void read_chunks(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, const struct frame_range *range,
+                        const char *raw_fname, size_t chunk_size, void (*flush)(struct gta_frames *, void *), void *arg, 
+                        struct gta_frames *frames, int *natoms, output_env_t *oenv) {
+    t_trxstatus *status = NULL;
+    rvec *x = NULL; // the whole system in the frame being read
+    matrix box;
+    real t, t0;
+    atom_id *sel; // indexes of the selected atoms of every group, one group after another
+    int nsel = select_atoms(numgroups, indx, isize, &sel);
+    struct xtc_index index;
+
+    if(raw_fname && map_raw(raw_fname, traj_fname, sel, nsel, range, frames, natoms) == 0) {
+        if(flush) {
+            flush(frames, arg);
+            frames->nframes = 0;
+        }
+        sfree(sel);
+        return;
+    }
+
+    // XTC frames are found first and then decoded in parallel, other formats are read by GROMACS one frame at a time
+    int cached = 0;
+    int xtc = is_xtc(traj_fname) && xtc_cached_index(traj_fname, &index, &cached) == 0;
+    if(xtc) {
+        *natoms = index.natoms;
+        print_log("%s %d frames of %d atoms in %s.\n", cached ? "Loaded the index of" : "Found", 
+            index.nframes, index.natoms, traj_fname);
+    }
+    else {
+        *natoms = read_first_x(*oenv, &status, traj_fname, &t, &x, box);
+        t0 = t;
+    }
+
+    check_atoms(traj_fname, numgroups, indx, isize, *natoms);
+    if(indx == NULL)    nsel = *natoms;
+
+    int stride = (range && range->stride > 1) ? range->stride : 1;
+    int nin = 0; // Number of frames read within the times of range
+    int nread = 0; // Number of frames kept, including those already passed to flush
+    int chunk = 0; // Number of frames held at a time if flushing
+    if(flush) {
+        chunk = chunk_size / (3 * nsel * sizeof(real)) / PACK_BLOCK * PACK_BLOCK;
+        if(chunk < PACK_BLOCK)  chunk = PACK_BLOCK;
+    }
+    if(xtc) { // select the frames from the index, before decoding any
+        int *fr_sel, nfr_sel = select_xtc_frames(traj_fname, &index, range, &fr_sel);
+
+        print_log("Decoding %d of %d frames of %s", nfr_sel, index.nframes, traj_fname);
+#ifdef _OPENMP
+        if(omp_get_max_threads() > 1)
+            print_log(" with %d threads", omp_get_max_threads());
+#endif
+        print_log("...\n");
+
+        int n = (chunk > 0 && chunk < nfr_sel) ? chunk : nfr_sel; // Frames decoded at a time
+        frames_init(frames, nsel, n);
+        for(int k = 0; k < nfr_sel; k += n) {
+            frames->nframes = k + n < nfr_sel ? n : nfr_sel - k;
+            decode_xtc(traj_fname, &index, fr_sel + k, NULL, frames->nframes, sel, frames);
+            if(flush) {
+                flush(frames, arg);
+                frames->nframes = 0;
+            }
+        }
+        sfree(fr_sel);
+        xtc_free_index(&index);
+    }
+    else {
+        frames_init(frames, nsel, FRAMESTEP);
+
+        do {
+            if(range && range->end >= 0 && t > range->end)  break;
+            if(frame_in_time(range, t, t0) && nin++ % stride == 0) {
+                frames_append(frames, x, sel, box, t);
+                ++nread;
+                if(flush && frames->nframes == chunk) {
+                    flush(frames, arg);
+                    frames->nframes = 0;
+                }
+            }
+        } while(read_next_x(*oenv, status, &t,
+#ifndef GRO_V5
+            *natoms,
+#endif
+            x, box));
+
+        sfree(x);
+        close_trx(status);
+
+        if(flush && frames->nframes > 0) {
+            flush(frames, arg);
+            frames->nframes = 0;
+        }
+        if(nread == 0) {
+            log_fatal(FARGS, "No frames of %s are in the selected time range.\n", traj_fname);
+        }
+    }
+
+    if(raw_fname && !flush) {
+        if(write_raw(raw_fname, traj_fname, sel, *natoms, range, frames) == 0)
+            print_log("Saved %d frames of %d atoms to %s.\n", frames->nframes, frames->natoms, raw_fname);
+        else
+            print_log("Could not save the frames to %s.\n", raw_fname);
+    }
+
+    sfree(sel);
+}
+
+
+void frames_free(struct gta_frames *frames) {
+    if(frames->map)
+        munmap(frames->map, frames->map_size);
+    else
+        free(frames->data);
+    sfree(frames->box);
+    sfree(frames->time);
+    if(frames->source) {
+        xtc_free_index(&frames->source->index);
+        sfree(frames->source->fname);
+        sfree(frames->source->fr_sel);
+        if(frames->source->sel)     sfree(frames->source->sel);
+        sfree(frames->source->decoded);
+        sfree(frames->source);
+    }
+    frames->data = NULL;
+    frames->map = NULL;
+    frames->nframes = frames->capacity = 0;
+}
+
+
+void packed_init(struct gta_packed_frames *packed, real precision) {
+    packed->blocks = NULL;
+    packed->box = NULL;
+    packed->time = NULL;
+    packed->nblocks = packed->nframes = packed->natoms = 0;
+    packed->stride = 0;
+    packed->precision = precision;
+    packed->size = 0;
+}
+
+
+void packed_add(struct gta_packed_frames *packed, const struct gta_frames *frames) {
+    int nframes = frames->nframes;
+    if(nframes == 0)    return;
+    if(packed->nframes == 0) {
+        packed->natoms = frames->natoms;
+        packed->stride = frames->stride;
+    }
+
+    int first = packed->nframes, nblocks = (nframes + PACK_BLOCK - 1) / PACK_BLOCK;
+    srenew(packed->blocks, packed->nblocks + nblocks);
+    srenew(packed->box, first + nframes);
+    srenew(packed->time, first + nframes);
+
+    struct packed_block *blocks = packed->blocks + packed->nblocks;
+    size_t size = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:size) shared(blocks,frames,packed)
+    for(int b = 0; b < nblocks; ++b) {
+        int fr = b * PACK_BLOCK;
+        pack_block(frames, fr, fr + PACK_BLOCK < nframes ? PACK_BLOCK : nframes - fr, packed->precision, &blocks[b]);
+        blocks[b].first = first + fr;
+        size += (4 + (blocks[b].nframes - 1) * blocks[b].width) * 3 * packed->stride;
+    }
+
+    memcpy(packed->box + first, frames->box, nframes * sizeof(matrix));
+    memcpy(packed->time + first, frames->time, nframes * sizeof(real));
+    packed->nblocks += nblocks;
+    packed->nframes += nframes;
+    packed->size += size;
+}
+
+
+void packed_decode(const struct gta_packed_frames *packed, int block, struct gta_frames *frames) {
+    const struct packed_block *b = &packed->blocks[block];
+    size_t n = 3 * packed->stride; // integers in each frame
+    real scale = 1.0 / packed->precision;
+    int32_t *acc;
+
+    snew(acc, n);
+    memcpy(acc, b->data, n * sizeof(int32_t));
+
+    // Each frame is the running sum of the differences, over all of its planes at once
+    for(int f = 0; f < b->nframes; ++f) {
+        real *restrict x = frames->data + f * n;
+        if(f > 0) {
+            const char *diff = b->data + (4 + (f - 1) * b->width) * n;
+            if(b->width == 1) {
+                const int8_t *restrict d = (const int8_t *)diff;
+                for(size_t i = 0; i < n; ++i)   acc[i] += d[i];
+            }
+            else if(b->width == 2) {
+                const int16_t *restrict d = (const int16_t *)diff;
+                for(size_t i = 0; i < n; ++i)   acc[i] += d[i];
+            }
+            else {
+                const int32_t *restrict d = (const int32_t *)diff;
+                for(size_t i = 0; i < n; ++i)   acc[i] += d[i];
+            }
+        }
+        for(size_t i = 0; i < n; ++i) {
+            x[i] = acc[i] * scale;
+        }
+        copy_mat(packed->box[b->first + f], frames->box[f]);
+        frames->time[f] = packed->time[b->first + f];
+    }
+    frames->nframes = b->nframes;
+
+    sfree(acc);
+}
+
+
+void read_packed_frames(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, const struct frame_range *range,
+    const char *raw_fname, real precision, struct gta_packed_frames *packed, int *natoms, output_env_t *oenv) {
+    struct gta_frames frames;
+
+    packed_init(packed, precision);
+    if(raw_fname) { // the raw file is written from all of the frames at once
+        read_frames(traj_fname, numgroups, indx, isize, range, raw_fname, &frames, natoms, oenv);
+        packed_add(packed, &frames);
+    }
+    else {
+        read_chunks(traj_fname, numgroups, indx, isize, range, NULL, PACK_CHUNK, pack_chunk, packed, &frames, natoms, oenv);
+    }
+    frames_free(&frames);
+
+    size_t unpacked = 3 * (size_t)packed->nframes * packed->stride * sizeof(real);
+    print_log("Packed %d frames of %d atoms into %.1f MB (%.1f times less than unpacked).\n", packed->nframes, packed->natoms, 
+        packed->size / 1048576.0, packed->size > 0 ? (double)unpacked / packed->size : 0.0);
+}
+
+
+void packed_free(struct gta_packed_frames *packed) {
+    for(int b = 0; b < packed->nblocks; ++b) {
+        sfree(packed->blocks[b].data);
+    }
+    sfree(packed->blocks);
+    sfree(packed->box);
+    sfree(packed->time);
+    packed->nblocks = packed->nframes = 0;
+    packed->size = 0;
+}
+
+
+int follow_open(struct frames_follower *fl, const char *traj_fname, int numgroups, atom_id **indx, const int *isize, 
+                real wait, int *natoms) {
+    int n = 0, ret;
+    real waited = 0;
+
+    memset(fl, 0, sizeof(*fl));
+    xtc_decoder_init(&fl->dec);
+    snew(fl->fname, strlen(traj_fname) + 1);
+    strcpy(fl->fname, traj_fname);
+
+    // The simulation may not have created the file yet
+    while((fl->f = fopen(traj_fname, "rb")) == NULL) {
+        if(waited >= wait) {
+            return -1;
+        }
+        pause_follow();
+        waited += FOLLOW_POLL;
+    }
+
+    // The number of atoms is in the header of every frame, so wait for the first one
+    while((ret = xtc_skip_frame(fl->f, &n, NULL, NULL, NULL)) != 1) {
+        if(ret < 0 && !feof(fl->f)) { // all of the frame is there, so it is not just being written
+            log_fatal(FARGS, "The first frame of %s is not a valid XTC frame.\n", traj_fname);
+        }
+        if(waited >= wait) {
+            return -1;
+        }
+        clearerr(fl->f);
+        fseeko(fl->f, 0, SEEK_SET);
+        pause_follow();
+        waited += FOLLOW_POLL;
+    }
+    fseeko(fl->f, 0, SEEK_SET);
+    fl->natoms = *natoms = n;
+
+    check_atoms(traj_fname, numgroups, indx, isize, n);
+    fl->nsel = select_atoms(numgroups, indx, isize, &fl->sel);
+    if(indx == NULL)    fl->nsel = n;
+    snew(fl->x, 3 * n);
+    snew(fl->xr, n);
+    return 0;
+}
+
+
+int follow_read(struct frames_follower *fl, struct gta_frames *frames, int max_frames, real wait) {
+    float time, box[3][3];
+    matrix mbox;
+    real waited = 0;
+
+    frames->nframes = 0;
+    while(frames->nframes < max_frames) {
+        if(!follow_frame(fl, &time, box)) {
+            if(frames->nframes > 0 || waited >= wait)   break;
+            pause_follow();
+            waited += FOLLOW_POLL;
+            continue;
+        }
+
+        for(int i = 0; i < fl->natoms; ++i) {
+            fl->xr[i][XX] = fl->x[3*i];
+            fl->xr[i][YY] = fl->x[3*i + 1];
+            fl->xr[i][ZZ] = fl->x[3*i + 2];
+        }
+        for(int d = 0; d < DIM; ++d) {
+            for(int e = 0; e < DIM; ++e) {
+                mbox[d][e] = box[d][e];
+            }
+        }
+        frames_append(frames, fl->xr, fl->sel, mbox, time);
+        ++fl->nframes;
+    }
+    return frames->nframes;
+}
+
+
+void follow_close(struct frames_follower *fl) {
+    if(fl->f)   fclose(fl->f);
+    xtc_decoder_free(&fl->dec);
+    sfree(fl->fname);
+    sfree(fl->x);
+    sfree(fl->xr);
+    sfree(fl->sel);
+    fl->f = NULL;
+}
+
+
+static real *alloc_frames(size_t nreals) {
+    size_t size = nreals * sizeof(real);
+    size_t align = size >= FRAMES_HUGEPAGE ? FRAMES_HUGEPAGE : FRAMES_ALIGN;
+    void *data = NULL;
+
+    if(posix_memalign(&data, align, size > 0 ? size : FRAMES_ALIGN) != 0) {
+        log_fatal(FARGS, "Could not allocate %lu bytes for trajectory frames.\n", (unsigned long)size);
+    }
+#ifdef MADV_HUGEPAGE
+    if(align == FRAMES_HUGEPAGE) {
+        madvise(data, size, MADV_HUGEPAGE); // only advice, so failure is harmless
+    }
+#endif
+    return data;
+}
+
+
+static int compare_ints(const void *a, const void *b) {
+    int i = *(const int *)a, j = *(const int *)b;
+    return (i > j) - (i < j);
+}
+
+static int is_xtc(const char *fname) {
+    const char *ext = strrchr(fname, '.');
+    return ext != NULL && strcmp(ext, ".xtc") == 0;
+}
+
+
+static int select_atoms(int numgroups, atom_id **indx, const int *isize, atom_id **sel) {
+    int nsel = 0;
+
+    *sel = NULL;
+    if(indx == NULL)    return 0;
+    for(int g = 0; g < numgroups; ++g) {
+        nsel += isize[g];
+    }
+    snew(*sel, nsel);
+    for(int g = 0, n = 0; g < numgroups; n += isize[g++]) {
+        memcpy(*sel + n, indx[g], isize[g] * sizeof(atom_id));
+    }
+    return nsel;
+}
+
+static void check_atoms(const char *traj_fname, int numgroups, atom_id **indx, const int *isize, int natoms) {
+    if(indx == NULL)    return;
+    for(int g = 0; g < numgroups; ++g) {
+        for(int j = 0; j < isize[g]; ++j) {
+            if(indx[g][j] >= natoms) {
+                log_fatal(FARGS, "Index %d of group %d is out of range: %s has %d atoms.\n",
+                    indx[g][j] + 1, g + 1, traj_fname, natoms);
+            }
+        }
+    }
+}
+
+static int select_xtc_frames(const char *traj_fname, const struct xtc_index *index, const struct frame_range *range, int **fr_sel) {
+    int stride = (range && range->stride > 1) ? range->stride : 1;
+    int nin = 0, nfr_sel = 0;
+
+    snew(*fr_sel, index->nframes);
+    for(int fr = 0; fr < index->nframes; ++fr) {
+        if(range && range->end >= 0 && index->times[fr] > range->end)   break;
+        if(frame_in_time(range, index->times[fr], index->times[0]) && nin++ % stride == 0) {
+            (*fr_sel)[nfr_sel++] = fr;
+        }
+    }
+    if(nfr_sel == 0) {
+        log_fatal(FARGS, "No frames of %s are in the selected time range.\n", traj_fname);
+    }
+    return nfr_sel;
+}
+
+static void decode_xtc(const char *traj_fname, const struct xtc_index *index, const int *fr_sel, const int *slots, int nfr_sel, 
+                       const atom_id *sel, const struct gta_frames *frames) {
+    int nframes = nfr_sel, natoms = index->natoms;
+    int failed = -1; // first frame that could not be decoded
+    int unreadable = 0;
+
+#pragma omp parallel shared(frames,index,fr_sel,sel,failed,unreadable)
+    {
+        FILE *f = fopen(traj_fname, "rb");
+        struct xtc_decoder dec;
+        float *x = malloc(3 * natoms * sizeof(float));
+        int next = -1; // frame at the position of f
+        xtc_decoder_init(&dec);
+
+#pragma omp for schedule(static)
+        for(int k = 0; k < nframes; ++k) {
+            int fr = fr_sel[k], slot = slots ? slots[k] : k; // frame of the file, stored as frame slot
+            if(f == NULL || x == NULL)  continue;
+            if(fr != next && fseeko(f, index->offsets[fr], SEEK_SET) != 0)  continue;
+            if(xtc_read_frame(f, &dec, natoms, NULL, NULL, NULL, x) != 1) {
+#pragma omp critical
+                if(failed < 0 || fr < failed)   failed = fr;
+                next = -1;
+                continue;
+            }
+            next = fr + 1;
+
+            real *px = frames->data + 3 * (size_t)slot * frames->stride;
+            real *py = px + frames->stride, *pz = py + frames->stride;
+            for(int i = 0; i < frames->natoms; ++i) {
+                const float *xi = &x[3 * (sel ? sel[i] : i)];
+                px[i] = xi[XX];
+                py[i] = xi[YY];
+                pz[i] = xi[ZZ];
+            }
+            for(int d = 0; d < DIM; ++d) {
+                for(int e = 0; e < DIM; ++e) {
+                    frames->box[slot][d][e] = index->boxes[fr][d][e];
+                }
+            }
+            frames->time[slot] = index->times[fr];
+        }
+
+        if(f == NULL || x == NULL) {
+#pragma omp critical
+            unreadable = 1;
+        }
+        if(f)   fclose(f);
+        free(x);
+        xtc_decoder_free(&dec);
+    }
+
+    if(unreadable) {
+        log_fatal(FARGS, "Could not open %s for reading.\n", traj_fname);
+    }
+    if(failed >= 0) {
+        log_fatal(FARGS, "Could not decode frame %d of %s.\n", failed, traj_fname);
+    }
+}
+
+
+static int source_stamp(const char *fname, int64_t stamp[3]) {
+    struct stat st;
+    if(stat(fname, &st) != 0)   return -1;
+    stamp[0] = st.st_size;
+    stamp[1] = st.st_mtim.tv_sec;
+    stamp[2] = st.st_mtim.tv_nsec;
+    return 0;
+}
+
+
+static void raw_range(const struct frame_range *range, float r[3], int32_t *skip) {
+    r[0] = (range && range->begin >= 0) ? range->begin : -1;
+    r[1] = (range && range->end >= 0) ? range->end : -1;
+    r[2] = (range && range->dt > 0) ? range->dt : 0;
+    *skip = (range && range->stride > 1) ? range->stride : 1;
+}
+
+
+static int map_raw(const char *raw_fname, const char *traj_fname, const atom_id *sel, int nsel, 
+                   const struct frame_range *range, struct gta_frames *frames, int *natoms) {
+    int fd = open(raw_fname, O_RDONLY);
+    struct stat st;
+    if(fd < 0)  return -1;
+    if(fstat(fd, &st) != 0 || st.st_size < RAW_HEADER) {
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    char *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping stays valid
+    if(map == MAP_FAILED)   return -1;
+
+    int64_t saved[3], stamp[3], data_offset;
+    int32_t n[4], skip, want_skip; // source_natoms, natoms, nframes, stride
+    float r[3], want[3];
+    memcpy(saved, map + 8, sizeof(saved));
+    memcpy(n, map + 32, sizeof(n));
+    memcpy(&data_offset, map + 48, sizeof(data_offset));
+    memcpy(r, map + 56, sizeof(r));
+    memcpy(&skip, map + 68, sizeof(skip));
+    int source_natoms = n[0], raw_natoms = n[1], nframes = n[2];
+    size_t stride = n[3];
+
+    int ok = memcmp(map, "GTARAW1", 8) == 0 
+        && source_natoms > 0 && raw_natoms > 0 && raw_natoms <= source_natoms && nframes > 0 && stride >= (size_t)raw_natoms 
+        && data_offset % RAW_PAGE == 0 
+        && (size_t)data_offset >= RAW_HEADER + raw_natoms * sizeof(int32_t) + nframes * 10 * sizeof(float) 
+        && (size_t)data_offset + 3 * nframes * stride * sizeof(float) <= size;
+    // A trajectory that is gone is fine, as the raw file can stand in for it
+    if(ok && source_stamp(traj_fname, stamp) == 0 && memcmp(stamp, saved, sizeof(stamp)) != 0) {
+        print_log("%s was not made from %s as it is now, so it will be replaced.\n", raw_fname, traj_fname);
+        ok = 0;
+    }
+    // Frames saved for another range are only of use if they are every frame
+    raw_range(range, want, &want_skip);
+    int whole = r[0] < 0 && r[1] < 0 && r[2] <= 0 && skip <= 1;
+    int same = memcmp(r, want, sizeof(r)) == 0 && skip == want_skip;
+    if(ok && !whole && !same) {
+        print_log("%s holds other frames than those selected, so it will be replaced.\n", raw_fname);
+        ok = 0;
+    }
+
+    const int32_t *atoms = (const int32_t *)(map + RAW_HEADER);
+    const float *times = (const float *)(atoms + raw_natoms);
+    const float (*boxes)[3][3] = (const float (*)[3][3])(times + nframes);
+    int *slot = NULL; // position in the raw file of each atom of the source, or -1
+    int *pos = NULL; // position in the raw file of each selected atom
+    int *fr_sel = NULL, nfr_sel = 0;
+
+    if(ok) {
+        if(sel == NULL)     nsel = source_natoms;
+        snew(slot, source_natoms);
+        snew(pos, nsel);
+        for(int a = 0; a < source_natoms; ++a)  slot[a] = -1;
+        for(int i = 0; i < raw_natoms && ok; ++i) {
+            ok = atoms[i] >= 0 && atoms[i] < source_natoms;
+            if(ok)  slot[atoms[i]] = i;
+        }
+        for(int i = 0; i < nsel && ok; ++i) {
+            int a = sel ? (int)sel[i] : i;
+            ok = a < source_natoms && slot[a] >= 0;
+            if(ok)  pos[i] = slot[a];
+        }
+        if(!ok) {
+            print_log("%s does not hold all of the selected atoms, so it will be replaced.\n", raw_fname);
+        }
+    }
+
+    if(ok) {
+        int stride_fr = same ? 1 : want_skip, nin = 0;
+        snew(fr_sel, nframes);
+        for(int fr = 0; fr < nframes; ++fr) {
+            if(!same && want[1] >= 0 && times[fr] > want[1])    break;
+            if((same || frame_in_time(range, times[fr], times[0])) && nin++ % stride_fr == 0) {
+                fr_sel[nfr_sel++] = fr;
+            }
+        }
+        if(nfr_sel == 0) {
+            log_fatal(FARGS, "No frames of %s are in the selected time range.\n", raw_fname);
+        }
+    }
+
+    if(!ok) {
+        sfree(slot);
+        sfree(pos);
+        munmap(map, size);
+        return -1;
+    }
+
+    int identity = nsel == raw_natoms && nfr_sel == nframes && sizeof(real) == sizeof(float);
+    for(int i = 0; i < nsel && identity; ++i) {
+        identity = pos[i] == i;
+    }
+
+    if(identity) { // the file already is the frame store
+        frames->data = (real *)(map + data_offset);
+        frames->natoms = raw_natoms;
+        frames->nframes = frames->capacity = nframes;
+        frames->stride = stride;
+        frames->map = map;
+        frames->map_size = size;
+        frames->source = NULL;
+        snew(frames->box, nframes);
+        snew(frames->time, nframes);
+#ifdef MADV_WILLNEED
+        madvise(map, size, MADV_WILLNEED); // start reading the frames in before they are needed
+#endif
+        print_log("Mapped %d frames of %d atoms from %s.\n", nframes, raw_natoms, raw_fname);
+    }
+    else { // gather the selected atoms and frames into a new frame store
+        frames_init(frames, nsel, nfr_sel);
+        frames->nframes = nfr_sel;
+        print_log("Reading %d of %d frames of %d atoms from %s...\n", nfr_sel, nframes, nsel, raw_fname);
+    }
+
+#pragma omp parallel for schedule(static) shared(frames,fr_sel,pos,times,boxes)
+    for(int k = 0; k < nfr_sel; ++k) {
+        int fr = fr_sel[k];
+        if(!identity) {
+            const float *src = (const float *)(map + data_offset) + 3 * fr * stride;
+            real *dst = frames->data + 3 * k * frames->stride;
+            for(int d = 0; d < DIM; ++d) {
+                for(int i = 0; i < nsel; ++i) {
+                    dst[d * frames->stride + i] = src[d * stride + pos[i]];
+                }
+            }
+        }
+        for(int d = 0; d < DIM; ++d) {
+            for(int e = 0; e < DIM; ++e) {
+                frames->box[k][d][e] = boxes[fr][d][e];
+            }
+        }
+        frames->time[k] = times[fr];
+    }
+
+    if(!identity) {
+        munmap(map, size);
+    }
+    *natoms = source_natoms;
+    sfree(slot);
+    sfree(pos);
+    sfree(fr_sel);
+    return 0;
+}
+
+
+static int write_raw(const char *raw_fname, const char *traj_fname, const atom_id *sel, int source_natoms, 
+                     const struct frame_range *range, const struct gta_frames *frames) {
+    size_t per_line = FRAMES_ALIGN / sizeof(float);
+    int natoms = frames->natoms, nframes = frames->nframes;
+    size_t stride = (natoms + per_line - 1) / per_line * per_line;
+    size_t meta = RAW_HEADER + natoms * sizeof(int32_t) + nframes * 10 * sizeof(float);
+    int64_t stamp[3], data_offset = (meta + RAW_PAGE - 1) / RAW_PAGE * RAW_PAGE;
+    int32_t n[4] = {source_natoms, natoms, nframes, stride}, skip;
+    float r[3];
+
+    if(source_stamp(traj_fname, stamp) != 0)    return -1;
+    raw_range(range, r, &skip);
+
+    int32_t *atoms;
+    float *times, (*boxes)[3][3], *plane;
+    snew(atoms, natoms);
+    snew(times, nframes);
+    snew(boxes, nframes);
+    snew(plane, stride); // padding stays 0
+    for(int i = 0; i < natoms; ++i) {
+        atoms[i] = sel ? sel[i] : i;
+    }
+    for(int fr = 0; fr < nframes; ++fr) {
+        times[fr] = frames->time[fr];
+        for(int d = 0; d < DIM; ++d) {
+            for(int e = 0; e < DIM; ++e) {
+                boxes[fr][d][e] = frames->box[fr][d][e];
+            }
+        }
+    }
+
+    size_t len = strlen(raw_fname);
+    char *tmp_fname;
+    snew(tmp_fname, len + 5);
+    memcpy(tmp_fname, raw_fname, len);
+    memcpy(tmp_fname + len, ".tmp", 5);
+
+    // Written to a temporary file first, so that a run reading the file never sees a partial one
+    FILE *f = fopen(tmp_fname, "wb");
+    int ok = f != NULL 
+        && fwrite("GTARAW1", 1, 8, f) == 8 
+        && fwrite(stamp, sizeof(int64_t), 3, f) == 3 
+        && fwrite(n, sizeof(int32_t), 4, f) == 4 
+        && fwrite(&data_offset, sizeof(int64_t), 1, f) == 1 
+        && fwrite(r, sizeof(float), 3, f) == 3 
+        && fwrite(&skip, sizeof(int32_t), 1, f) == 1 
+        && fwrite(atoms, sizeof(int32_t), natoms, f) == (size_t)natoms 
+        && fwrite(times, sizeof(float), nframes, f) == (size_t)nframes 
+        && fwrite(boxes, sizeof(*boxes), nframes, f) == (size_t)nframes 
+        && fseeko(f, data_offset, SEEK_SET) == 0; // the gap reads as zeros
+    for(int fr = 0; fr < nframes && ok; ++fr) {
+        for(int d = 0; d < DIM && ok; ++d) {
+            const real *src = frames->data + (3 * fr + d) * frames->stride;
+            for(int i = 0; i < natoms; ++i) {
+                plane[i] = src[i];
+            }
+            ok = fwrite(plane, sizeof(float), stride, f) == stride;
+        }
+    }
+    if(f)   ok = fclose(f) == 0 && ok;
+
+    if(!ok || rename(tmp_fname, raw_fname) != 0) {
+        remove(tmp_fname);
+        ok = 0;
+    }
+    sfree(tmp_fname);
+    sfree(atoms);
+    sfree(times);
+    sfree(boxes);
+    sfree(plane);
+    return ok ? 0 : -1;
+}
+
+
+static void pack_block(const struct gta_frames *frames, int first, int nframes, real precision, struct packed_block *block) {
+    size_t n = 3 * frames->stride; // integers in each frame
+    int32_t *ints, maxdiff = 0;
+
+    // Round every frame to integers, then find the largest difference between consecutive frames
+    snew(ints, nframes * n);
+    for(int f = 0; f < nframes; ++f) {
+        const real *x = frames->data + (first + f) * n;
+        int32_t *xi = ints + f * n;
+        for(int d = 0; d < DIM; ++d) { // the padding of each plane is left 0
+            for(int i = 0; i < frames->natoms; ++i) {
+                xi[d * frames->stride + i] = (int32_t)lrint(x[d * frames->stride + i] * precision);
+            }
+        }
+        if(f > 0) {
+            const int32_t *prev = xi - n;
+            for(size_t i = 0; i < n; ++i) {
+                int32_t diff = abs(xi[i] - prev[i]);
+                if(diff > maxdiff)  maxdiff = diff;
+            }
+        }
+    }
+
+    int width = maxdiff <= INT8_MAX ? 1 : maxdiff <= INT16_MAX ? 2 : 4;
+    block->nframes = nframes;
+    block->width = width;
+    snew(block->data, (4 + (nframes - 1) * width) * n);
+    memcpy(block->data, ints, n * sizeof(int32_t));
+
+    for(int f = 1; f < nframes; ++f) {
+        const int32_t *xi = ints + f * n, *prev = xi - n;
+        char *diff = block->data + (4 + (f - 1) * width) * n;
+        if(width == 1) {
+            int8_t *d = (int8_t *)diff;
+            for(size_t i = 0; i < n; ++i)   d[i] = xi[i] - prev[i];
+        }
+        else if(width == 2) {
+            int16_t *d = (int16_t *)diff;
+            for(size_t i = 0; i < n; ++i)   d[i] = xi[i] - prev[i];
+        }
+        else {
+            int32_t *d = (int32_t *)diff;
+            for(size_t i = 0; i < n; ++i)   d[i] = xi[i] - prev[i];
+        }
+    }
+
+    sfree(ints);
+}
+
+
+static void pack_chunk(struct gta_frames *frames, void *packed) {
+    packed_add(packed, frames);
+}
+
+
+static int follow_frame(struct frames_follower *fl, float *time, float box[3][3]) {
+    // A frame still being written runs past the end of the file, so it is read again from its start once more has been written.
+    // A frame that fails to decode before the end of the file is corrupt, and waiting would not help.
+    int ret = xtc_read_frame(fl->f, &fl->dec, fl->natoms, NULL, time, box, fl->x);
+    if(ret < 0 && !feof(fl->f)) {
+        log_fatal(FARGS, "Frame %d of %s, at byte %lld, is corrupt.\n", fl->nframes, fl->fname, (long long)fl->offset);
+    }
+    if(ret != 1) {
+        clearerr(fl->f);
+        fseeko(fl->f, fl->offset, SEEK_SET);
+        return 0;
+    }
+    fl->offset = ftello(fl->f);
+    return 1;
+}
+
+
+static void pause_follow(void) {
+    struct timespec ts = {0, (long)(FOLLOW_POLL * 1e9)};
+    nanosleep(&ts, NULL);
+}
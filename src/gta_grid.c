@@ -19,9 +19,22 @@
 
 #include "gkut_io.h"
 #include "gkut_log.h"
+#include "gta_frames.h"
 
 static real gta_diag, gta_diag2;
 
+static void frames_bounds(const struct gta_frames *frames, rvec min, rvec max);
+/* Extends the bounds min and max to include every atom of frames.
+ */
+
+static void alloc_grid(const rvec min, const rvec max, real cell_width, struct tessellated_grid *grid);
+/* Allocates a grid of cells of width cell_width covering the bounds min and max.
+ */
+
+static void load_frames(const struct gta_frames *frames, real (*fweight)(rvec, rvec), struct tessellated_grid *grid);
+/* Adds the weights of the atoms of frames to grid, whose diagonals gta_diag and gta_diag2 must be set.
+ */
+
 real weight_dist(rvec traj_point, rvec grid_point) {
     return gta_diag - sqrt(distance2(traj_point, grid_point));
 }
@@ -31,133 +44,117 @@ real weight_dist2(rvec traj_point, rvec grid_point) {
 }
 
 
-void gta_grid_area(const char *traj_fname, const char *ndx_fname, 
-    real cell_width, real (*fweight)(rvec, rvec), output_env_t *oenv, struct tessellated_grid *grid) {
-    rvec **pre_x, **x;
-    matrix *box;
-    int nframes, natoms;
-
-    read_traj(traj_fname, &pre_x, &box, &nframes, &natoms, oenv);
-    sfree(box);
+void gta_grid_area(const char *traj_fname, const char *ndx_fname, const struct frame_range *range, const char *raw_fname, 
+    real precision, real cell_width, real (*fweight)(rvec, rvec), output_env_t *oenv, struct tessellated_grid *grid) {
+    struct gta_frames frames;
+    struct gta_packed_frames packed;
+    int natoms;
 
-    // Filter trajectory by index file if present
+    // Only keep the atoms in the index file if present
     if(ndx_fname != NULL) {
-        ndx_filter_traj(ndx_fname, pre_x, &x, nframes, &natoms);
-
-        for(int i = 0; i < nframes; ++i) {
-            sfree(pre_x[i]);
-        }
-        sfree(pre_x);
+        atom_id **indx;
+        int *isize;
+
+        ndx_get_indx(ndx_fname, 1, &indx, &isize);
+        if(precision > 0)
+            read_packed_frames(traj_fname, 1, indx, isize, range, raw_fname, precision, &packed, &natoms, oenv);
+        else
+            read_frames(traj_fname, 1, indx, isize, range, raw_fname, &frames, &natoms, oenv);
+
+        sfree(indx[0]);
+        sfree(indx);
+        sfree(isize);
+    }
+    else if(precision > 0) {
+        read_packed_frames(traj_fname, 0, NULL, NULL, range, raw_fname, precision, &packed, &natoms, oenv);
     }
     else {
-        x = pre_x;
+        read_frames(traj_fname, 0, NULL, NULL, range, raw_fname, &frames, &natoms, oenv);
     }
 
-    f_gta_grid_area(x, nframes, natoms, cell_width, fweight, grid);
-
-    // free memory
-    for(int i = 0; i < nframes; ++i) {
-        sfree(x[i]);
+    if(precision > 0) {
+        f_gta_grid_area_packed(&packed, cell_width, fweight, grid);
+        packed_free(&packed);
+    }
+    else {
+        f_gta_grid_area(&frames, cell_width, fweight, grid);
+        frames_free(&frames);
     }
-    sfree(x);
 }
 
 
-void f_gta_grid_area(rvec **x, int nframes, int natoms, 
+void f_gta_grid_area(const struct gta_frames *frames, 
     real cell_width, real (*fweight)(rvec, rvec), struct tessellated_grid *grid) {
-    construct_grid(x, nframes, natoms, cell_width, grid);
+    construct_grid(frames, cell_width, grid);
 
-    load_grid(x, nframes, natoms, fweight, grid);
+    load_grid(frames, fweight, grid);
 
     gen_heightmap(grid);
 
     tessellate_grid(grid);
 
-    grid->area_per_particle = grid->surface_area / natoms;
+    grid->area_per_particle = grid->surface_area / frames->natoms;
 }
 
 
-void construct_grid(rvec **x, int nframes, int natoms, real cell_width, struct tessellated_grid *grid) {
-    real minx = FLT_MAX, miny = FLT_MAX, minz = FLT_MAX, 
-        maxx = FLT_MIN, maxy = FLT_MIN, maxz = FLT_MIN;
-    int dimx, dimy, dimz;
+void f_gta_grid_area_packed(const struct gta_packed_frames *packed, 
+    real cell_width, real (*fweight)(rvec, rvec), struct tessellated_grid *grid) {
+    construct_packed_grid(packed, cell_width, grid);
 
-    for(int fr = 0; fr < nframes; ++fr) {
-        for(int a = 0; a < natoms; ++a) {
-            if(x[fr][a][XX] < minx) minx = x[fr][a][XX];
-            if(x[fr][a][XX] > maxx) maxx = x[fr][a][XX];
+    load_packed_grid(packed, fweight, grid);
 
-            if(x[fr][a][YY] < miny) miny = x[fr][a][YY];
-            if(x[fr][a][YY] > maxy) maxy = x[fr][a][YY];
+    gen_heightmap(grid);
 
-            if(x[fr][a][ZZ] < minz) minz = x[fr][a][ZZ];
-            if(x[fr][a][ZZ] > maxz) maxz = x[fr][a][ZZ];
-        }
-    }
+    tessellate_grid(grid);
 
-    // # weights in each dim is the # grid cells - 1 + an extra grid cell (bc of int cast floor) + 1 for the last grid point
-    dimx = ((int)((maxx - minx)/cell_width) + 2);
-    dimy = ((int)((maxy - miny)/cell_width) + 2);
-    dimz = ((int)((maxz - minz)/cell_width) + 2);
+    grid->area_per_particle = grid->surface_area / packed->natoms;
+}
 
-    snew(grid->weights, dimx * dimy * dimz);
-    snew(grid->heightmap, dimx * dimy);
-    snew(grid->areas, (dimx-1) * (dimy-1));
-    grid->dimx = dimx, grid->dimy = dimy, grid->dimz = dimz;
-    grid->cell_width = cell_width;
-    grid->minx = minx, grid->miny = miny, grid->minz = minz;
-#ifdef GTA_DEBUG
-    print_log("maxx = %f, maxy = %f, maxz = %f\n", maxx, maxy, maxz);
-#endif
+
+void construct_grid(const struct gta_frames *frames, real cell_width, struct tessellated_grid *grid) {
+    rvec min = {FLT_MAX, FLT_MAX, FLT_MAX}, max = {FLT_MIN, FLT_MIN, FLT_MIN};
+
+    frames_bounds(frames, min, max);
+
+    alloc_grid(min, max, cell_width, grid);
 }
 
 
-void load_grid(rvec **x, int nframes, int natoms, real (*fweight)(rvec, rvec), struct tessellated_grid *grid) {
-    real *weights = grid->weights;
-    int dimx = grid->dimx, dimy = grid->dimy, dimz = grid->dimz;
-    int dimyz = dimy * dimz;
-    real cell_width = grid->cell_width;
-    real minx = grid->minx, miny = grid->miny, minz = grid->minz;
+void construct_packed_grid(const struct gta_packed_frames *packed, real cell_width, struct tessellated_grid *grid) {
+    rvec min = {FLT_MAX, FLT_MAX, FLT_MAX}, max = {FLT_MIN, FLT_MIN, FLT_MIN};
+    struct gta_frames frames;
+
+    frames_init(&frames, packed->natoms, PACK_BLOCK);
+    for(int b = 0; b < packed->nblocks; ++b) {
+        packed_decode(packed, b, &frames);
+        frames_bounds(&frames, min, max);
+    }
+    frames_free(&frames);
+
+    alloc_grid(min, max, cell_width, grid);
+}
+
 
-    gta_diag2 = 3 * cell_width * cell_width;
+void load_grid(const struct gta_frames *frames, real (*fweight)(rvec, rvec), struct tessellated_grid *grid) {
+    gta_diag2 = 3 * grid->cell_width * grid->cell_width;
     gta_diag = sqrt(gta_diag2);
 
-    rvec grid_point;
-    int xi, yi, zi;
+    load_frames(frames, fweight, grid);
+}
 
-    for(int fr = 0; fr < nframes; ++fr) {
-        for(int a = 0; a < natoms; ++a) {
-            // Indices of the origin point of the grid cell surrounding this atom
-            xi = (int)((x[fr][a][XX] - minx)/cell_width);
-            yi = (int)((x[fr][a][YY] - miny)/cell_width);
-            zi = (int)((x[fr][a][ZZ] - minz)/cell_width);
 
-            // Load the eight grid points around this atom. Closer distance to atom = higher weight
-            grid_point[XX] = minx + xi * cell_width;
-            grid_point[YY] = miny + yi * cell_width; 
-            grid_point[ZZ] = minz + zi * cell_width;
-            // This order of operations is an attempt to minimize cache misses
-            weights[xi*dimyz + yi*dimz + zi]            += fweight(x[fr][a], grid_point);
-            grid_point[ZZ] += cell_width;
-            weights[xi*dimyz + yi*dimz + zi+1]          += fweight(x[fr][a], grid_point);
-            grid_point[YY] += cell_width;
-            grid_point[ZZ] -= cell_width;
-            weights[xi*dimyz + (yi+1)*dimz + zi]        += fweight(x[fr][a], grid_point);
-            grid_point[ZZ] += cell_width;
-            weights[xi*dimyz + (yi+1)*dimz + zi+1]      += fweight(x[fr][a], grid_point);
-            grid_point[XX] += cell_width;
-            grid_point[YY] -= cell_width;
-            grid_point[ZZ] -= cell_width;
-            weights[(xi+1)*dimyz + yi*dimz + zi]        += fweight(x[fr][a], grid_point);
-            grid_point[ZZ] += cell_width;
-            weights[(xi+1)*dimyz + yi*dimz + zi+1]      += fweight(x[fr][a], grid_point);
-            grid_point[YY] += cell_width;
-            grid_point[ZZ] -= cell_width;
-            weights[(xi+1)*dimyz + (yi+1)*dimz + zi]    += fweight(x[fr][a], grid_point);
-            grid_point[ZZ] += cell_width;
-            weights[(xi+1)*dimyz + (yi+1)*dimz + zi+1]  += fweight(x[fr][a], grid_point);
-        }
+void load_packed_grid(const struct gta_packed_frames *packed, real (*fweight)(rvec, rvec), struct tessellated_grid *grid) {
+    struct gta_frames frames;
+
+    gta_diag2 = 3 * grid->cell_width * grid->cell_width;
+    gta_diag = sqrt(gta_diag2);
+
+    frames_init(&frames, packed->natoms, PACK_BLOCK);
+    for(int b = 0; b < packed->nblocks; ++b) {
+        packed_decode(packed, b, &frames);
+        load_frames(&frames, fweight, grid);
     }
+    frames_free(&frames);
 }
 
 
@@ -218,7 +215,7 @@ void tessellate_grid(struct tessellated_grid *grid) {
                 || ((i_heights[1] = heightmap[x*dimy + y+1]) < 0) 
                 || ((i_heights[2] = heightmap[(x+1)*dimy + y]) < 0) 
                 || ((i_heights[3] = heightmap[(x+1)*dimy + y+1]) < 0)) {
-                areas[x*dimy + y] = 0.0;
+                areas[x*(dimy-1) + y] = 0.0;
                 continue;
             }
 
@@ -318,3 +315,97 @@ void free_grid(struct tessellated_grid *grid) {
     sfree(grid->heightmap);
     sfree(grid->areas);
 }
+
+
+static void frames_bounds(const struct gta_frames *frames, rvec min, rvec max) {
+    int nframes = frames->nframes, natoms = frames->natoms;
+
+    // One plane at a time, so that each bounds loop runs over contiguous coordinates
+    for(int fr = 0; fr < nframes; ++fr) {
+        const real *px = frames_x(frames, fr), *py = frames_y(frames, fr), *pz = frames_z(frames, fr);
+
+        for(int a = 0; a < natoms; ++a) {
+            if(px[a] < min[XX]) min[XX] = px[a];
+            if(px[a] > max[XX]) max[XX] = px[a];
+        }
+        for(int a = 0; a < natoms; ++a) {
+            if(py[a] < min[YY]) min[YY] = py[a];
+            if(py[a] > max[YY]) max[YY] = py[a];
+        }
+        for(int a = 0; a < natoms; ++a) {
+            if(pz[a] < min[ZZ]) min[ZZ] = pz[a];
+            if(pz[a] > max[ZZ]) max[ZZ] = pz[a];
+        }
+    }
+}
+
+
+static void alloc_grid(const rvec min, const rvec max, real cell_width, struct tessellated_grid *grid) {
+    int dimx, dimy, dimz;
+
+    // # weights in each dim is the # grid cells - 1 + an extra grid cell (bc of int cast floor) + 1 for the last grid point
+    dimx = ((int)((max[XX] - min[XX])/cell_width) + 2);
+    dimy = ((int)((max[YY] - min[YY])/cell_width) + 2);
+    dimz = ((int)((max[ZZ] - min[ZZ])/cell_width) + 2);
+
+    snew(grid->weights, dimx * dimy * dimz);
+    snew(grid->heightmap, dimx * dimy);
+    snew(grid->areas, (dimx-1) * (dimy-1));
+    grid->dimx = dimx, grid->dimy = dimy, grid->dimz = dimz;
+    grid->cell_width = cell_width;
+    grid->minx = min[XX], grid->miny = min[YY], grid->minz = min[ZZ];
+#ifdef GTA_DEBUG
+    print_log("maxx = %f, maxy = %f, maxz = %f\n", max[XX], max[YY], max[ZZ]);
+#endif
+}
+
+
+static void load_frames(const struct gta_frames *frames, real (*fweight)(rvec, rvec), struct tessellated_grid *grid) {
+    int nframes = frames->nframes, natoms = frames->natoms;
+    real *weights = grid->weights;
+    int dimy = grid->dimy, dimz = grid->dimz;
+    int dimyz = dimy * dimz;
+    real cell_width = grid->cell_width;
+    real minx = grid->minx, miny = grid->miny, minz = grid->minz;
+
+    rvec grid_point, xa;
+    int xi, yi, zi;
+
+    for(int fr = 0; fr < nframes; ++fr) {
+        const real *px = frames_x(frames, fr), *py = frames_y(frames, fr), *pz = frames_z(frames, fr);
+
+        for(int a = 0; a < natoms; ++a) {
+            xa[XX] = px[a], xa[YY] = py[a], xa[ZZ] = pz[a];
+
+            // Indices of the origin point of the grid cell surrounding this atom
+            xi = (int)((xa[XX] - minx)/cell_width);
+            yi = (int)((xa[YY] - miny)/cell_width);
+            zi = (int)((xa[ZZ] - minz)/cell_width);
+
+            // Load the eight grid points around this atom. Closer distance to atom = higher weight
+            grid_point[XX] = minx + xi * cell_width;
+            grid_point[YY] = miny + yi * cell_width; 
+            grid_point[ZZ] = minz + zi * cell_width;
+            // This order of operations is an attempt to minimize cache misses
+            weights[xi*dimyz + yi*dimz + zi]            += fweight(xa, grid_point);
+            grid_point[ZZ] += cell_width;
+            weights[xi*dimyz + yi*dimz + zi+1]          += fweight(xa, grid_point);
+            grid_point[YY] += cell_width;
+            grid_point[ZZ] -= cell_width;
+            weights[xi*dimyz + (yi+1)*dimz + zi]        += fweight(xa, grid_point);
+            grid_point[ZZ] += cell_width;
+            weights[xi*dimyz + (yi+1)*dimz + zi+1]      += fweight(xa, grid_point);
+            grid_point[XX] += cell_width;
+            grid_point[YY] -= cell_width;
+            grid_point[ZZ] -= cell_width;
+            weights[(xi+1)*dimyz + yi*dimz + zi]        += fweight(xa, grid_point);
+            grid_point[ZZ] += cell_width;
+            weights[(xi+1)*dimyz + yi*dimz + zi+1]      += fweight(xa, grid_point);
+            grid_point[YY] += cell_width;
+            grid_point[ZZ] -= cell_width;
+            weights[(xi+1)*dimyz + (yi+1)*dimz + zi]    += fweight(xa, grid_point);
+            grid_point[ZZ] += cell_width;
+            weights[(xi+1)*dimyz + (yi+1)*dimz + zi+1]  += fweight(xa, grid_point);
+        }
+    }
+}
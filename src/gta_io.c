@@ -0,0 +1,276 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ *
+ * This program uses the GROMACS molecular simulation package API.
+ * Copyright (c) 1991-2000, University of Groningen, The Netherlands.
+ * Copyright (c) 2001-2004, The GROMACS development team.
+ * Copyright (c) 2013,2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed at http://www.gromacs.org.
+ */
+
+#define _XOPEN_SOURCE 500 // for pwrite
+
+#include "gta_io.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "gkut_log.h"
+#include "gmx_fatal.h"
+#include "smalloc.h"
+
+#define TRI_DUMP_HEADER 24 // Size of the container header in bytes
+#define PLY_BUFSIZE (1 << 20) // Size of the stdio buffers of PLY files
+#define PLY_COUNT_FMT "%020lld" // Fixed width element counts, so they can be filled in after writing
+
+static const char *ply_header = 
+    "ply\n"
+    "format binary_little_endian 1.0\n"
+    "comment g_tessla triangulated surfaces\n"
+    "element vertex " PLY_COUNT_FMT "\n"
+    "property float x\n"
+    "property float y\n"
+    "property float z\n"
+    "property int frame\n"
+    "property int surface\n"
+    "element face " PLY_COUNT_FMT "\n"
+    "property list uchar int vertex_indices\n"
+    "end_header\n";
+
+
+static void pwrite_all(int fd, const void *buf, size_t size, int64_t offset);
+/* pwrite()s the whole buffer, exiting on error.
+ */
+
+static void put_le32(unsigned char *dest, const void *src);
+/* Copies a 32-bit value to dest in little-endian byte order.
+ */
+
+static void write_ply_header(struct ply_writer *ply);
+
+
+void open_tri_dump(const char *fname, int nframes, int nsurf, struct tri_dump *dump) {
+    dump->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(dump->fd < 0) {
+        log_fatal(FARGS, "Could not open %s for writing.\n", fname);
+    }
+
+    dump->nframes = nframes;
+    dump->nsurf = nsurf;
+    snew(dump->offsets, nframes * nsurf);
+    dump->end = TRI_DUMP_HEADER; // The header is written at closing, once the table's offset is known
+}
+
+void write_tri_dump(struct tri_dump *dump, 
+                    int fr, 
+                    int surf, 
+                    const rvec *x, 
+                    const struct dTriangulation *tri) {
+    int64_t size = 4 * sizeof(int32_t) 
+                 + 3 * tri->npoints * sizeof(float) 
+                 + 3 * tri->ntriangles * sizeof(int32_t);
+    int64_t offset;
+
+    // Assemble the record in memory so that it can be written with one call
+    char *rec;
+    snew(rec, size);
+
+    int32_t *head = (int32_t*)rec;
+    head[0] = fr;
+    head[1] = surf;
+    head[2] = tri->npoints;
+    head[3] = tri->ntriangles;
+
+    float *points = (float*)(head + 4);
+    for(int i = 0; i < tri->npoints; ++i) {
+        points[3*i]     = x[i][XX];
+        points[3*i + 1] = x[i][YY];
+        points[3*i + 2] = x[i][ZZ];
+    }
+
+    int32_t *triangles = (int32_t*)(points + 3 * tri->npoints);
+    for(int i = 0; i < 3 * tri->ntriangles; ++i) {
+        triangles[i] = tri->triangles[i];
+    }
+
+    // Reserve a region at the end of the file for this record
+#pragma omp atomic capture
+    { offset = dump->end; dump->end += size; }
+
+    pwrite_all(dump->fd, rec, size, offset);
+    dump->offsets[fr * dump->nsurf + surf] = offset;
+
+    sfree(rec);
+}
+
+void close_tri_dump(struct tri_dump *dump) {
+    char header[TRI_DUMP_HEADER];
+    int32_t counts[2] = {dump->nframes, dump->nsurf};
+    int64_t table_offset = dump->end;
+
+    pwrite_all(dump->fd, dump->offsets, dump->nframes * dump->nsurf * sizeof(int64_t), table_offset);
+
+    memset(header, 0, sizeof(header));
+    strncpy(header, TRI_DUMP_MAGIC, 8);
+    memcpy(header + 8, counts, sizeof(counts));
+    memcpy(header + 16, &table_offset, sizeof(table_offset));
+    pwrite_all(dump->fd, header, TRI_DUMP_HEADER, 0);
+
+    close(dump->fd);
+    sfree(dump->offsets);
+}
+
+
+void open_ply(const char *fname, struct ply_writer *ply) {
+    ply->f = fopen(fname, "wb");
+    ply->faces = tmpfile();
+    if(!ply->f || !ply->faces) {
+        log_fatal(FARGS, "Could not open %s for writing.\n", fname);
+    }
+    setvbuf(ply->f, NULL, _IOFBF, PLY_BUFSIZE);
+    setvbuf(ply->faces, NULL, _IOFBF, PLY_BUFSIZE);
+
+    ply->nverts = 0;
+    ply->nfaces = 0;
+    write_ply_header(ply);
+}
+
+void write_ply(struct ply_writer *ply, 
+               int fr, 
+               int surf, 
+               const rvec *x, 
+               const struct dTriangulation *tri) {
+    const int VERTSIZE = 5 * 4, FACESIZE = 1 + 3 * 4;
+    unsigned char *verts, *faces;
+    snew(verts, tri->npoints * VERTSIZE);
+    snew(faces, tri->ntriangles * FACESIZE);
+
+    // Encode the vertices outside of the critical section
+    for(int i = 0; i < tri->npoints; ++i) {
+        float p[3] = {x[i][XX], x[i][YY], x[i][ZZ]};
+        int32_t ids[2] = {fr, surf};
+        unsigned char *v = verts + i * VERTSIZE;
+        put_le32(v, &p[0]);
+        put_le32(v + 4, &p[1]);
+        put_le32(v + 8, &p[2]);
+        put_le32(v + 12, &ids[0]);
+        put_le32(v + 16, &ids[1]);
+    }
+
+#pragma omp critical(gta_ply)
+    {
+        // Faces index the vertices of the whole mesh, so they can only be encoded once this surface's first vertex is known
+        int32_t ind;
+        for(int i = 0; i < tri->ntriangles; ++i) {
+            unsigned char *t = faces + i * FACESIZE;
+            t[0] = 3;
+            for(int j = 0; j < 3; ++j) {
+                ind = ply->nverts + tri->triangles[3*i + j];
+                put_le32(t + 1 + 4*j, &ind);
+            }
+        }
+
+        fwrite(verts, VERTSIZE, tri->npoints, ply->f);
+        fwrite(faces, FACESIZE, tri->ntriangles, ply->faces);
+        ply->nverts += tri->npoints;
+        ply->nfaces += tri->ntriangles;
+    }
+
+    sfree(verts);
+    sfree(faces);
+}
+
+void close_ply(struct ply_writer *ply) {
+    char *buf;
+    size_t n;
+    snew(buf, PLY_BUFSIZE);
+
+    rewind(ply->faces);
+    while((n = fread(buf, 1, PLY_BUFSIZE, ply->faces)) > 0) {
+        fwrite(buf, 1, n, ply->f);
+    }
+    fclose(ply->faces);
+    sfree(buf);
+
+    rewind(ply->f);
+    write_ply_header(ply);
+
+    if(fclose(ply->f) != 0) {
+        log_fatal(FARGS, "Failed to write PLY file.\n");
+    }
+}
+
+
+void open_atom_file(const char *fname, 
+                    const char *magic, 
+                    int nframes, 
+                    int natoms, 
+                    int ncols, 
+                    struct atom_writer *aw) {
+    char header[ATOM_HEADER];
+    int32_t dims[4] = {nframes, natoms, ncols, 0};
+
+    aw->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(aw->fd < 0) {
+        log_fatal(FARGS, "Could not open %s for writing.\n", fname);
+    }
+    aw->nframes = nframes;
+    aw->natoms = natoms;
+    aw->ncols = ncols;
+
+    memset(header, 0, sizeof(header));
+    strncpy(header, magic, 8);
+    memcpy(header + 8, dims, sizeof(dims));
+    pwrite_all(aw->fd, header, ATOM_HEADER, 0);
+}
+
+void write_atom_frame(struct atom_writer *aw, int fr, const real *values) {
+    int64_t n = (int64_t)aw->natoms * aw->ncols;
+    float *buf;
+    snew(buf, n);
+
+    for(int64_t i = 0; i < n; ++i) {
+        buf[i] = values[i];
+    }
+    pwrite_all(aw->fd, buf, n * sizeof(float), ATOM_HEADER + fr * n * sizeof(float));
+
+    sfree(buf);
+}
+
+void close_atom_file(struct atom_writer *aw) {
+    // Make sure the file has its full size even if the last frames were never written
+    if(ftruncate(aw->fd, ATOM_HEADER + (int64_t)aw->nframes * aw->natoms * aw->ncols * sizeof(float)) != 0
+        || close(aw->fd) != 0) {
+        log_fatal(FARGS, "Failed to write per-atom data.\n");
+    }
+}
+
+
+static void write_ply_header(struct ply_writer *ply) {
+    fprintf(ply->f, ply_header, (long long)ply->nverts, (long long)ply->nfaces);
+}
+
+static void put_le32(unsigned char *dest, const void *src) {
+    uint32_t v;
+    memcpy(&v, src, 4);
+    dest[0] = v & 0xff;
+    dest[1] = (v >> 8) & 0xff;
+    dest[2] = (v >> 16) & 0xff;
+    dest[3] = (v >> 24) & 0xff;
+}
+
+static void pwrite_all(int fd, const void *buf, size_t size, int64_t offset) {
+    const char *p = buf;
+    ssize_t written;
+
+    while(size > 0) {
+        written = pwrite(fd, p, size, offset);
+        if(written < 0) {
+            log_fatal(FARGS, "Failed to write triangulation data.\n");
+        }
+        p += written;
+        offset += written;
+        size -= written;
+    }
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#define _XOPEN_SOURCE 700 // for getline
+
+#include "gta_ndx.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static int add_group(struct ndx_group **groups, int *ngroups, int *capacity, const char *name, size_t len);
+/* Appends an empty group named by the len characters of name. Returns 0 on success and -1 if out of memory.
+ */
+
+
+int ndx_read(const char *fname, struct ndx_group **groups, int *ngroups) {
+    FILE *f = fopen(fname, "r");
+    char *line = NULL;
+    size_t line_size = 0;
+    int capacity = 0, atom_capacity = 0, ok = f != NULL;
+
+    *groups = NULL;
+    *ngroups = 0;
+    while(ok && getline(&line, &line_size, f) >= 0) {
+        char *p = line;
+        while(isspace((unsigned char)*p))   ++p;
+
+        if(*p == '[') { // a new group
+            char *end = strchr(p, ']');
+            if(end == NULL) {
+                ok = 0;
+                break;
+            }
+            ++p;
+            while(p < end && isspace((unsigned char)*p))    ++p;
+            while(end > p && isspace((unsigned char)end[-1]))   --end;
+            ok = add_group(groups, ngroups, &capacity, p, end - p) == 0;
+            atom_capacity = 0;
+            continue;
+        }
+
+        while(ok && *p != '\0') { // atom numbers of the last group
+            char *next;
+            long a = strtol(p, &next, 10);
+            if(next == p) {
+                ok = isspace((unsigned char)*p) != 0;
+                ++p;
+                continue;
+            }
+            if(*ngroups == 0 || a < 1) {
+                ok = 0;
+                break;
+            }
+            struct ndx_group *g = &(*groups)[*ngroups - 1];
+            if(g->natoms >= atom_capacity) {
+                atom_capacity = atom_capacity ? 2 * atom_capacity : 1024;
+                int *atoms = realloc(g->atoms, atom_capacity * sizeof(*atoms));
+                if(atoms == NULL) {
+                    ok = 0;
+                    break;
+                }
+                g->atoms = atoms;
+            }
+            g->atoms[g->natoms++] = (int)(a - 1);
+            p = next;
+        }
+    }
+
+    free(line);
+    if(f)   fclose(f);
+    if(!ok) {
+        ndx_free(*groups, *ngroups);
+        *groups = NULL;
+        *ngroups = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int ndx_find(const struct ndx_group *groups, int ngroups, const char *name) {
+    for(int g = 0; g < ngroups; ++g) {
+        if(strcasecmp(groups[g].name, name) == 0)   return g;
+    }
+    return -1;
+}
+
+void ndx_free(struct ndx_group *groups, int ngroups) {
+    for(int g = 0; g < ngroups; ++g) {
+        free(groups[g].name);
+        free(groups[g].atoms);
+    }
+    free(groups);
+}
+
+
+static int add_group(struct ndx_group **groups, int *ngroups, int *capacity, const char *name, size_t len) {
+    if(*ngroups >= *capacity) {
+        int n = *capacity ? 2 * *capacity : 16;
+        struct ndx_group *g = realloc(*groups, n * sizeof(*g));
+        if(g == NULL)   return -1;
+        *groups = g;
+        *capacity = n;
+    }
+
+    struct ndx_group *g = &(*groups)[*ngroups];
+    g->name = malloc(len + 1);
+    if(g->name == NULL)     return -1;
+    memcpy(g->name, name, len);
+    g->name[len] = '\0';
+    g->atoms = NULL;
+    g->natoms = 0;
+    ++*ngroups;
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#include "gta_stats.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static void welford_add(long *n, double *mean, double *m2, double x);
+/* Adds a sample to a running mean and sum of squared deviations.
+ */
+
+static void welford_merge(long *n, double *mean, double *m2, long nb, double meanb, double m2b);
+/* Combines two running means and sums of squared deviations (Chan et al.).
+ */
+
+static void finish_block(struct gta_stats *s, int l, long long start, double sum);
+/* Adds the average of the finished block of level l that starts at sample start, whose samples in s add up to sum, 
+ * or keeps sum as the head of level l if the block started before the first sample of s.
+ */
+
+
+void stats_init(struct gta_stats *s) {
+    stats_init_at(s, 0);
+}
+
+void stats_init_at(struct gta_stats *s, long first) {
+    memset(s, 0, sizeof(*s));
+    s->first = first;
+}
+
+void stats_add(struct gta_stats *s, double x) {
+    long long i = (long long)s->first + s->n; // index of the sample in the series
+    welford_add(&s->n, &s->mean, &s->m2, x);
+
+    // Add the sample to the last block of each level, finishing the blocks that end with it
+    for(int l = 0; l < STATS_MAXLEVELS; ++l) {
+        long long size = 1LL << l, start = i & ~(size - 1);
+
+        s->tail[l] += x;
+        if(i + 1 == start + size) {
+            finish_block(s, l, start, s->tail[l]);
+            s->tail[l] = 0;
+        }
+    }
+}
+
+void stats_merge(struct gta_stats *dest, const struct gta_stats *src) {
+    if(src->n == 0)     return;
+    if(dest->n == 0) {
+        *dest = *src;
+        return;
+    }
+
+    long long b = src->first; // first sample of src, right after the last of dest
+    welford_merge(&dest->n, &dest->mean, &dest->m2, src->n, src->mean, src->m2);
+
+    for(int l = 0; l < STATS_MAXLEVELS; ++l) {
+        long long size = 1LL << l, start = b & ~(size - 1);
+
+        if(start == b) { // no block spans both stretches
+            dest->tail[l] = src->tail[l];
+        }
+        else if(src->has_head[l]) { // the block that spans both stretches ends in src
+            finish_block(dest, l, start, dest->tail[l] + src->head[l]);
+            dest->tail[l] = src->tail[l];
+        }
+        else { // src ends within the block that dest ends in
+            dest->tail[l] += src->tail[l];
+        }
+
+        welford_merge(&dest->bn[l], &dest->bmean[l], &dest->bm2[l], src->bn[l], src->bmean[l], src->bm2[l]);
+        if(src->bn[l] > 0 && l >= dest->nlevels)    dest->nlevels = l + 1;
+    }
+}
+
+double stats_var(const struct gta_stats *s) {
+    return s->n > 1 ? s->m2 / (s->n - 1) : 0;
+}
+
+double stats_sem(const struct gta_stats *s) {
+    double sem = s->n > 0 ? sqrt(stats_var(s) / s->n) : 0, bsem;
+
+    for(int l = 1; l < s->nlevels; ++l) {
+        if(s->bn[l] < STATS_MINBLOCKS)  break;
+
+        bsem = sqrt(s->bm2[l] / (s->bn[l] - 1) / s->bn[l]);
+        if(bsem > sem)  sem = bsem;
+    }
+
+    return sem;
+}
+
+double stats_tau(const struct gta_stats *s) {
+    double var = stats_var(s), sem = stats_sem(s);
+
+    if(var <= 0)    return 0;
+    return (s->n * sem * sem / var - 1) / 2;
+}
+
+
+void hist_init(struct gta_hist *h, int nbins, double max) {
+    h->nbins = nbins;
+    h->max = max;
+    h->count = (long*)calloc(nbins, sizeof(long));
+    h->nover = 0;
+    h->n = 0;
+}
+
+void hist_add(struct gta_hist *h, double x) {
+    ++h->n;
+    if(x >= h->max) {
+        ++h->nover;
+        return;
+    }
+
+    int bin = (int)(x / h->max * h->nbins);
+    if(bin < 0)     bin = 0;
+    if(bin >= h->nbins)     bin = h->nbins - 1;
+    ++h->count[bin];
+}
+
+void hist_merge(struct gta_hist *dest, const struct gta_hist *src) {
+    for(int i = 0; i < dest->nbins; ++i) {
+        dest->count[i] += src->count[i];
+    }
+    dest->nover += src->nover;
+    dest->n += src->n;
+}
+
+void hist_free(struct gta_hist *h) {
+    free(h->count);
+    h->count = NULL;
+}
+
+
+static void welford_add(long *n, double *mean, double *m2, double x) {
+    double delta = x - *mean;
+    ++(*n);
+    *mean += delta / *n;
+    *m2 += delta * (x - *mean);
+}
+
+static void welford_merge(long *n, double *mean, double *m2, long nb, double meanb, double m2b) {
+    if(nb == 0)     return;
+
+    long na = *n, nab = na + nb;
+    double delta = meanb - *mean;
+
+    *mean += delta * nb / nab;
+    *m2 += m2b + delta * delta * ((double)na * nb / nab);
+    *n = nab;
+}
+
+static void finish_block(struct gta_stats *s, int l, long long start, double sum) {
+    if(start < s->first) { // finished when merged with the stretch before s
+        s->head[l] = sum;
+        s->has_head[l] = 1;
+        return;
+    }
+
+    welford_add(&s->bn[l], &s->bmean[l], &s->bm2[l], ldexp(sum, -l));
+    if(l >= s->nlevels)     s->nlevels = l + 1;
+}
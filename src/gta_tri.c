@@ -12,77 +12,523 @@
 #include "gta_tri.h"
 
 #include <float.h>
+#include <stdint.h>
 #include <string.h>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
-#ifdef GTA_BENCH
 #include <time.h>
-#endif
 #include "gkut_io.h"
 #include "gkut_log.h"
+#include "gmx_fatal.h"
 #include "smalloc.h"
 #include "delaunay_tri.h"
+#include "gta_io.h"
+
+#define GTA_BOLTZ 0.0083144621 // Boltzmann constant in kJ/mol/K
+#define GTA_KJMOLNM2_MNM 1.660539 // 1 kJ/mol/nm^2 in mN/m
+#define FOLLOW_BATCH 256 // Largest number of frames of a followed trajectory tessellated together
+#define CPT_FLAGS (GTA_CORRECT | GTA_2D | GTA_LEAFLETS | GTA_PSI6 | GTA_CURVATURE) // Flags that can be checkpointed
+
+
+// Sorted keys (see dtedge_key) of the neighbour pairs of a surface in a frame
+struct edge_set {
+    uint64_t *keys;
+    int n;
+};
+
+// Per-atom values of a frame for the per-atom files, indexed by atom within the whole frame or a group. NULL if not written.
+struct atom_frame {
+    real *area; // Area of each atom (GTA_ATOMAREA)
+    real *psi6; // Real and imaginary parts of the hexatic order parameter of each atom (GTA_ATOMPSI6)
+    real *curv; // Normal, mean and gaussian curvature of each atom (GTA_ATOMCURV)
+};
+
+// Options and output handles shared by all frames of a delaunay_tessellate run
+struct tri_run {
+    const struct tri_output *out; // Output options
+    int ngroups; // Number of groups
+    int nsurf; // Number of surfaces per group
+    int *offsets; // Offsets of each group's coordinates within a frame
+    int tot_atoms; // Number of atoms in all groups
+    rvec *frame_x; // Coordinates of the current frame of each thread, gathered from the planes of the frame store, indexed by [thread # * tot_atoms + atom]
+    rvec *leaf_x; // Coordinates of the upper and lower leaflets of the current group of each thread, indexed by [(thread # * 2 + leaflet) * tot_atoms + atom] (GTA_LEAFLETS)
+    int *leaf_ind; // Index of each atom of leaf_x within its group, indexed like leaf_x (GTA_LEAFLETS)
+    real espace; // Spacing of edge correction points (GTA_CORRECT)
+    real *map_area; // Area map histograms of each thread, indexed by [(thread # * # surfaces + surface #) * bins + bin] (GTA_AREAMAP)
+    int *map_count; // Atom counts of the area map histograms, indexed like map_area
+    int map_nbins; // Number of bins of each area map
+    struct gta_hist *hists; // Triangle area and edge length histograms of each thread, indexed by [(thread # * # surfaces + surface #) * 2 + 0 or 1] (GTA_HIST)
+    real *thick_sum; // Thickness map sums of each thread, indexed by [(thread # * # groups + group #) * bins + bin] (GTA_THICKNESS)
+    int *thick_count; // Number of frames summed in each bin of the thickness maps, indexed like thick_sum
+    real *thick_z; // Heights of both leaflets at the thickness map bins in the current frame of each thread, indexed by [(thread # * 2 + leaflet) * bins + bin]
+    int *thick_in; // Whether each bin lies within the leaflet, indexed like thick_z
+    struct edge_set *nb_prev; // Neighbours of each surface in the last frame of each thread, indexed by [thread # * # surfaces + surface #] (GTA_NEIGHBOURS)
+    int *nb_prev_fr; // Frame of each of nb_prev, -1 for none
+    struct edge_set *nb_heads; // Neighbours in frames whose previous frame was not the last of the same thread, indexed by [frame # * # surfaces + surface #]
+    struct edge_set *nb_tails; // Neighbours in frames whose next frame was not the next of the same thread, indexed like nb_heads
+    long *domain_sizes; // Domain size distributions of each thread, indexed by [((thread # * # surfaces + surface #) * ntypes + type #) * (max natoms + 1) + size] (GTA_DOMAINS)
+    int max_natoms; // Largest number of atoms of any group
+    int nthr; // Maximum number of threads
+    int warned_small; // Whether a surface with too few atoms to triangulate has been reported
+    struct tri_dump dump; // Triangulation container (GTA_PRINT)
+    struct ply_writer ply; // PLY mesh (GTA_PLY)
+    struct atom_writer atom_area; // Per-atom areas (GTA_ATOMAREA)
+    struct atom_writer atom_psi6; // Per-atom hexatic order parameters (GTA_ATOMPSI6)
+    struct atom_writer atom_curv; // Per-atom normals and curvatures (GTA_ATOMCURV)
+    unsigned char *cpt_done; // Whether each frame is finished, ie its values and statistics are stored (GTA_CHECKPOINT)
+    int cpt_ndone; // Number of finished frames
+    time_t cpt_time; // Time of the last checkpoint
+    unsigned char *cpt_snap_done; // Copy of cpt_done taken for the checkpoint being written
+    int cpt_writing; // Whether a thread is writing a checkpoint from the copy
+};
+
+/* Returns the number of the calling thread.
+ */
+static inline int thread_num() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+static void tessellate_frame(const struct gta_frames *frames, 
+                             int fr, 
+                             unsigned long flags, 
+                             struct tri_run *run, 
+                             struct tri_area *areas);
+/* Triangulates every surface of frame fr of frames and stores their areas in areas.
+ * Can be called by several threads at once for different frames.
+ */
+
+static void tessellate_until_converged(const struct gta_frames *frames, 
+                                       unsigned long flags, 
+                                       struct tri_run *run, 
+                                       struct tri_area *areas);
+/* Tessellates the frames in the order given by run->out->order, in parallel batches, 
+ * until the standard error of the mean area per particle of every surface is below run->out->tol.
+ * The statistics in areas are those of the tessellated frames, which are marked in areas[i].done.
+ */
+
+static void add_frame_stats(const struct tri_area *ga, int fr, struct gta_stats *st);
+/* Adds the areas of frame fr to the GTA_NSTATS statistics in st.
+ */
+
+static void splat_areas(const rvec *x, 
+                        const real *aa, 
+                        int natoms, 
+                        matrix box, 
+                        int nx, 
+                        int ny, 
+                        real *map_area, 
+                        int *map_count);
+/* Adds the area aa of each atom to the bin of an nx by ny area map histogram in which the atom lies.
+ * Atoms outside of the box are wrapped into it.
+ */
+
+static int atom_edges(const struct dTriangulation *tri, int natoms, uint64_t **edges);
+/* Finds the edges of tri between the first natoms points (ie not edge correction points) as sorted keys (see dtedges).
+ * Memory is allocated for *edges. free() it when done. Returns the number of edges.
+ */
+
+static void neighbour_frame(const uint64_t *edges, 
+                            int nedges, 
+                            const int *ind, 
+                            int natoms, 
+                            int fr, 
+                            int surf, 
+                            struct tri_run *run, 
+                            struct tri_area *ga);
+/* Stores the coordination number of surface surf in frame fr, and its neighbour exchange with the previous frame 
+ * if that was the last frame tessellated by this thread. Otherwise the neighbours are saved to be compared after the frame loop.
+ * The atoms' indices in edges are mapped to their indices in the group by ind, which can be NULL.
+ */
+
+static void resolve_exchange(struct tri_run *run, struct tri_area *areas);
+/* Calculates the neighbour exchange between the frames saved by neighbour_frame, and frees all saved neighbours.
+ */
+
+static int count_common(const uint64_t *a, int na, const uint64_t *b, int nb);
+/* Returns the number of keys in both of the sorted arrays a and b.
+ */
+
+static real hexatic_order(const rvec *x, 
+                          int natoms, 
+                          const uint64_t *edges, 
+                          int nedges, 
+                          const int *ind, 
+                          real *atom_psi6);
+/* Calculates the hexatic order parameter psi6 = <exp(6i theta)> of each of the natoms atoms of x 
+ * over the xy-angles theta of its bonds to its neighbours, given by edges.
+ * If atom_psi6 is not NULL, the real and imaginary parts for each atom are stored in it at the atom's index in ind (or in x if ind is NULL).
+ * Returns the average magnitude of psi6 over the atoms with neighbours.
+ */
+
+static void find_domains(const uint64_t *edges, 
+                         int nedges, 
+                         const int *ind, 
+                         int natoms, 
+                         const real *aa, 
+                         const int *types, 
+                         int fr, 
+                         struct tri_area *ga, 
+                         long *sizes, 
+                         int stride);
+/* Clusters the natoms atoms of a surface into domains of atoms of the same lipid type connected by edges, using union-find.
+ * types holds the type of each atom by its index in the group, given by ind (or by its index in the surface if ind is NULL).
+ * Stores the number of domains and the size and area (from the atom areas aa) of the largest domain of each type in frame fr of ga, 
+ * and adds the number of domains of each size to sizes, indexed by [type # * stride + size].
+ */
+
+static void surface_curvature(const rvec *x, 
+                              const struct dTriangulation *tri, 
+                              int natoms, 
+                              const int *ind, 
+                              int fr, 
+                              struct tri_area *ga, 
+                              real *atom_curv);
+/* Calculates the curvatures of the atoms of a triangulated surface with tri_surface_curvature 
+ * and stores their averages over the interior atoms in frame fr of ga.
+ * If atom_curv is not NULL, the normal, mean and gaussian curvature of each atom are stored in it 
+ * (5 values per atom) at the atom's index in ind (or in x if ind is NULL).
+ */
+
+static int uf_find(int *parent, int i);
+/* Returns the root of the set of i, halving the path to it.
+ */
+
+static void average_box(const struct tri_area *ga, matrix *box, matrix avg_box, int *nframes);
+/* Averages the boxes of the frames of ga that were tessellated, storing the number of them in nframes.
+ */
 
+static void map_nodes(matrix box, int nx, int ny, rvec *q);
+/* Stores the xy-positions of the centres of the nx by ny bins of a map over the given box in q.
+ */
+
+static void tessellate_surface(const rvec *x, 
+                               const int *ind, 
+                               int natoms, 
+                               matrix box, 
+                               real espace, 
+                               unsigned long flags, 
+                               int fr, 
+                               int surf, 
+                               struct tri_run *run, 
+                               struct tri_area *ga, 
+                               struct atom_frame *af);
+/* Triangulates surface number surf of frame fr and stores its areas in ga.
+ * ind holds the index within its group of each atom in x, or is NULL if x is the whole group.
+ * The per-atom values of the atoms in x are stored in the non-NULL arrays of af, indexed by atom within the group.
+ */
 
-void print_triangulation3D(const rvec *x, 
+static int add_edge_points(const rvec *x, 
+                           int natoms, 
                            matrix box, 
-                           const struct dTriangulation *tri, 
-                           int modelnum, 
-                           const char *fname);
-/* Prints a pdb file with connections between the triangulated atoms.
+                           real espace, 
+                           rvec **x_corr);
+/* Copies the given coordinates into *x_corr and adds points at regular intervals 
+ * along the edges and corners of the box to correct for periodic bounding.
+ * The box may be triclinic, in which case the points are added along the edges of 
+ * the parallelogram spanned by the xy-components of the first two box vectors.
+ * Memory is allocated for *x_corr. Returns the total number of points in *x_corr.
+ * Without atoms there is no height for the points, so none are added and *x_corr is NULL.
+ */
+
+static void print_stats(const char *name, const struct gta_stats *s);
+/* Logs the mean, variance, standard error and autocorrelation time of a time series.
+ */
+
+static void clear_tri_area(struct tri_area *ga);
+/* Sets the arrays of a tri_area struct to NULL, before any are allocated.
+ */
+
+static void lipid_types(atom_id **indx, const int *isize, int ngroups, int ntypes, int natoms, int ***types);
+/* Finds the lipid type of each atom of ngroups groups of indx from the ntypes groups after them (see tri_output).
+ * Memory is allocated for *types and its arrays.
+ */
+
+static void print_area_header(FILE *f, int ngroups, const struct tri_area *areas);
+static void print_area_row(FILE *f, int ngroups, const struct tri_area *areas, int fr);
+/* Print the column headers, and the values of frame fr, of the output of print_areas.
+ * Rows start with the time of their frame, so that frames can be matched to the trajectory whichever were selected.
+ */
+
+static void print_surface_stats(int ngroups, const struct tri_area *areas, int i);
+/* Logs the statistics of surface i of the areas, held in its stats array.
+ */
+
+static int read_checkpoint(const struct gta_frames *frames, 
+                           unsigned long flags, 
+                           struct tri_run *run, 
+                           struct tri_area *areas);
+/* Restores the finished frames into run->cpt_done and their values into areas from the checkpoint run->out->cpt_fname 
+ * (see gta_tri.h), if it was saved for the same frames, groups and flags. 
+ * Returns the number of finished frames, 0 if the file holds no such checkpoint.
+ */
+
+static int write_checkpoint(const struct gta_frames *frames, 
+                            unsigned long flags, 
+                            const struct tri_run *run, 
+                            const struct tri_area *areas, 
+                            const unsigned char *done);
+/* Saves the frames marked in done and their values to the checkpoint run->out->cpt_fname, 
+ * through a temporary file so that an interrupted write leaves the last checkpoint intact. 
+ * Returns 1 on success. done must not change during the call. The values of finished frames never change, 
+ * so other threads may keep triangulating.
+ */
+
+static int read_checkpoint_frame(FILE *f, struct tri_area *ga, int fr, unsigned long flags);
+/* Reads the values of frame fr of ga from f, as stored in a checkpoint. Returns 1 on success.
  */
 
-void print_dtrifiles(const struct dTriangulation *tri, 
-                     const char *node_name, 
-                     const char *ele_name);
+static int write_checkpoint_frame(FILE *f, const struct tri_area *ga, int fr, unsigned long flags);
+/* Writes the values of frame fr of ga to f, as stored in a checkpoint. Returns 1 on success.
+ */
 
 
 void tessellate_area(const char *traj_fname, 
                      const char *ndx_fname, 
+                     int ngroups, 
+                     const struct frame_range *range, 
+                     const char *raw_fname, 
                      output_env_t *oenv, 
                      real espace, 
                      int nthreads, 
                      struct tri_area *areas, 
-                     unsigned char flags) {
-    rvec **pre_x, **x;
-    matrix *box;
+                     const struct tri_output *out, 
+                     unsigned long flags) {
+    struct gta_frames frames;
+    int natoms, *isize;
+
+    if(ngroups < 1 || (ndx_fname == NULL && ngroups != 1)) {
+        log_fatal(FARGS, "An index file is needed to tessellate %d groups.\n", ngroups);
+    }
 
-    areas->area = NULL;
-    areas->area2D = NULL;
-    areas->area2Dbox = NULL;
+    int nsurf = (flags & GTA_LEAFLETS) ? 2 : 1; // Number of surfaces triangulated per group
 
-    read_traj(traj_fname, &pre_x, &box, &(areas->nframes), &(areas->natoms), oenv);
+    for(int i = 0; i < nsurf * ngroups; ++i) {
+        clear_tri_area(&areas[i]);
+    }
+
+    int ntypes = out ? out->ntypes : 0;
+    if(ntypes > 0 && ndx_fname == NULL) {
+        log_fatal(FARGS, "An index file is needed to select %d lipid types.\n", ntypes);
+    }
+#ifdef _OPENMP
+    if(nthreads > 0) // also the threads decoding the trajectory
+        omp_set_num_threads(nthreads);
+#endif
+
+    struct tri_output tout = {NULL}; // the output options with the lipid types filled in
+    if(out) {
+        tout = *out;
+        tout.types = NULL;
+    }
 
-    // Filter trajectory by index file if present
+    // Only keep the atoms of the selected groups if an index file is present
     if(ndx_fname != NULL) {
-        ndx_filter_traj(ndx_fname, pre_x, &x, areas->nframes, &(areas->natoms));
+        atom_id **indx;
 
-        for(int i = 0; i < areas->nframes; ++i) {
-            sfree(pre_x[i]);
+        ndx_get_indx(ndx_fname, ngroups + ntypes, &indx, &isize);
+
+        if(flags & GTA_ESTOP) // frames past convergence are never decoded
+            read_frames_lazy(traj_fname, ngroups, indx, isize, range, raw_fname, &frames, &natoms, oenv);
+        else
+            read_frames(traj_fname, ngroups, indx, isize, range, raw_fname, &frames, &natoms, oenv);
+
+        if(ntypes > 0) {
+            lipid_types(indx, isize, ngroups, ntypes, natoms, &tout.types);
+        }
+
+        for(int g = 0; g < ngroups + ntypes; ++g) {
+            sfree(indx[g]);
+        }
+        sfree(indx);
+    }
+    else {
+        if(flags & GTA_ESTOP)
+            read_frames_lazy(traj_fname, 0, NULL, NULL, range, raw_fname, &frames, &natoms, oenv);
+        else
+            read_frames(traj_fname, 0, NULL, NULL, range, raw_fname, &frames, &natoms, oenv);
+        snew(isize, 1);
+        isize[0] = natoms;
+    }
+
+    for(int i = 0; i < nsurf * ngroups; ++i) {
+        areas[i].natoms = isize[i / nsurf];
+        areas[i].nframes = frames.nframes;
+    }
+    sfree(isize);
+
+    delaunay_tessellate(&frames, espace, nthreads, ngroups, areas, out ? &tout : NULL, flags);
+
+    if(tout.types) {
+        for(int g = 0; g < ngroups; ++g) {
+            sfree(tout.types[g]);
+        }
+        sfree(tout.types);
+    }
+
+    frames_free(&frames);
+}
+
+
+void follow_area(const char *traj_fname, 
+                 const char *ndx_fname, 
+                 int ngroups, 
+                 const char *out_fname, 
+                 real wait, 
+                 int nflush, 
+                 real espace, 
+                 int nthreads, 
+                 struct tri_area *areas, 
+                 const struct tri_output *out, 
+                 unsigned long flags) {
+    const unsigned long others = GTA_PRINT | GTA_PLY | GTA_ATOMAREA | GTA_ESTOP | GTA_AREAMAP | GTA_HIST 
+        | GTA_THICKNESS | GTA_NEIGHBOURS | GTA_ATOMPSI6 | GTA_DOMAINS | GTA_ATOMCURV | GTA_CHECKPOINT; // need all frames or other outputs
+    struct frames_follower fl;
+    struct gta_frames frames;
+    atom_id **indx = NULL;
+    int natoms, *isize = NULL;
+
+    const char *ext = strrchr(traj_fname, '.');
+    if(ext == NULL || strcmp(ext, ".xtc") != 0) {
+        log_fatal(FARGS, "Only XTC files can be followed.\n");
+    }
+    if(flags & others) {
+        log_fatal(FARGS, "Only the areas, hexatic order and curvatures of each frame can be calculated while following a trajectory.\n");
+    }
+    if(ngroups < 1 || (ndx_fname == NULL && ngroups != 1)) {
+        log_fatal(FARGS, "An index file is needed to tessellate %d groups.\n", ngroups);
+    }
+    int ntypes = out ? out->ntypes : 0;
+    if(ntypes > 0 && ndx_fname == NULL) {
+        log_fatal(FARGS, "An index file is needed to select %d lipid types.\n", ntypes);
+    }
+
+    int nsurf = (flags & GTA_LEAFLETS) ? 2 : 1;
+    int nareas = nsurf * ngroups;
+    for(int i = 0; i < nareas; ++i) {
+        clear_tri_area(&areas[i]);
+    }
+#ifdef _OPENMP
+    if(nthreads > 0)
+        omp_set_num_threads(nthreads);
+#endif
+
+    struct tri_output tout = {NULL};
+    if(out) {
+        tout = *out;
+        tout.types = NULL;
+    }
+
+    if(ndx_fname != NULL) {
+        ndx_get_indx(ndx_fname, ngroups + ntypes, &indx, &isize);
+    }
+    if(follow_open(&fl, traj_fname, ngroups, indx, isize, wait, &natoms) != 0) {
+        log_fatal(FARGS, "No frames were written to %s within %g s.\n", traj_fname, wait);
+    }
+    if(indx != NULL) {
+        if(ntypes > 0) {
+            lipid_types(indx, isize, ngroups, ntypes, natoms, &tout.types);
         }
-        sfree(pre_x);
+        for(int g = 0; g < ngroups + ntypes; ++g) {
+            sfree(indx[g]);
+        }
+        sfree(indx);
     }
     else {
-        x = pre_x;
+        snew(isize, 1);
+        isize[0] = natoms;
+    }
+    for(int i = 0; i < nareas; ++i) {
+        areas[i].natoms = isize[i / nsurf];
+    }
+    sfree(isize);
+
+    struct gta_stats *total; // Statistics of all frames so far
+    snew(total, nareas * GTA_NSTATS);
+    for(int i = 0; i < nareas * GTA_NSTATS; ++i) {
+        stats_init(&total[i]);
+    }
+
+    FILE *f = fopen(out_fname, "w");
+    if(f == NULL) {
+        log_fatal(FARGS, "Could not open %s for writing.\n", out_fname);
+    }
+
+    print_log("Following %s, until no frame has been added for %g s...\n", traj_fname, wait);
+    frames_init(&frames, fl.nsel, FOLLOW_BATCH);
+
+    int nframes = 0, unflushed = 0, n;
+    while((n = follow_read(&fl, &frames, FOLLOW_BATCH, wait)) > 0) {
+        if(nframes > 0) { // the last batch's values have been written
+            for(int i = 0; i < nareas; ++i) {
+                free_tri_area(&areas[i]);
+                clear_tri_area(&areas[i]);
+            }
+        }
+        for(int i = 0; i < nareas; ++i) {
+            areas[i].nframes = n;
+        }
+
+        delaunay_tessellate(&frames, espace, nthreads, ngroups, areas, out ? &tout : NULL, flags | GTA_FOLLOW);
+
+        if(nframes == 0)    print_area_header(f, ngroups, areas);
+        for(int fr = 0; fr < n; ++fr) {
+            print_area_row(f, ngroups, areas, fr);
+        }
+        unflushed += n;
+        if(unflushed >= nflush) {
+            fflush(f);
+            unflushed = 0;
+        }
+
+        for(int fr = 0; fr < n; ++fr) { // in order, so the blocking analysis sees the whole series
+            for(int i = 0; i < nareas; ++i) {
+                add_frame_stats(&areas[i], fr, &total[i * GTA_NSTATS]);
+            }
+        }
+        nframes += n;
+        print_log("%d frames tessellated, up to %g ps. Average area per particle: %f\n", 
+            nframes, frames.time[n - 1], total[GTA_STAT_APL].mean);
     }
 
-    delaunay_tessellate(x, box, espace, nthreads, areas, flags);
+    fclose(f);
+    follow_close(&fl);
+    frames_free(&frames);
+    if(nframes == 0) {
+        log_fatal(FARGS, "No complete frames were written to %s within %g s.\n", traj_fname, wait);
+    }
+    print_log("Stopped following %s after %d frames, as no frame was added for %g s.\n", traj_fname, nframes, wait);
+
+    real temp = out ? out->temp : 0;
+    for(int i = 0; i < nareas; ++i) {
+        memcpy(areas[i].stats, &total[i * GTA_NSTATS], sizeof(areas[i].stats));
+        double var = stats_var(&areas[i].stats[GTA_STAT_BOX]);
+        areas[i].area_modulus = (temp > 0 && var > 0) ? GTA_BOLTZ * temp * areas[i].stats[GTA_STAT_BOX].mean / var : 0;
+        print_surface_stats(ngroups, areas, i);
+    }
+    print_log("Surface areas saved to %s\n", out_fname);
 
-    for(int i = 0; i < areas->nframes; ++i) {
-        sfree(x[i]);
+    if(tout.types) {
+        for(int g = 0; g < ngroups; ++g) {
+            sfree(tout.types[g]);
+        }
+        sfree(tout.types);
     }
-    sfree(x);
-    sfree(box);
+    sfree(total);
 }
 
 
-void delaunay_tessellate(rvec **x, 
-                         matrix *box, 
+void delaunay_tessellate(const struct gta_frames *frames, 
                          real espace, 
                          int nthreads, 
+                         int ngroups, 
                          struct tri_area *areas, 
-                         unsigned char flags) {
+                         const struct tri_output *out, 
+                         unsigned long flags) {
 #ifdef GTA_BENCH
     clock_t start = clock();
 #endif
@@ -90,235 +536,362 @@ void delaunay_tessellate(rvec **x,
 #ifdef _OPENMP
     if(nthreads > 0)
         omp_set_num_threads(nthreads);
-    if(nthreads > 1 || nthreads <= 0)
+#endif
+    if((flags & GTA_CHECKPOINT) && (flags & ~(CPT_FLAGS | GTA_CHECKPOINT))) {
+        log_fatal(FARGS, "Only the areas, hexatic order and curvatures of each frame can be checkpointed.\n");
+    }
+#ifdef _OPENMP
+    if((nthreads > 1 || nthreads <= 0) && !(flags & GTA_FOLLOW))
         print_log("Triangulation will be parallelized.\n");
 #endif
 
+    int nframes = areas[0].nframes;
+    int nsurf = (flags & GTA_LEAFLETS) ? 2 : 1; // Number of surfaces triangulated per group
+    int nareas = nsurf * ngroups;
+
+    struct tri_run run;
+    run.out = out;
+    run.nsurf = nsurf;
+    run.ngroups = ngroups;
+    run.espace = espace;
+    run.nthr = 1;
+#ifdef _OPENMP
+    run.nthr = omp_get_max_threads();
+#endif
+    run.warned_small = 0;
+
+    // Offsets of each group's coordinates within a frame
+    snew(run.offsets, ngroups);
+    for(int g = 1; g < ngroups; ++g) {
+        run.offsets[g] = run.offsets[g-1] + areas[(g-1) * nsurf].natoms;
+    }
+
+    int ntypes = out ? out->ntypes : 0;
+    run.tot_atoms = run.offsets[ngroups-1] + areas[(ngroups-1) * nsurf].natoms;
+
+    // Frame buffers of each thread, allocated once rather than every frame
+    snew(run.frame_x, run.nthr * run.tot_atoms);
+    run.leaf_x = NULL;
+    run.leaf_ind = NULL;
+    if(flags & GTA_LEAFLETS) {
+        snew(run.leaf_x, run.nthr * 2 * run.tot_atoms);
+        snew(run.leaf_ind, run.nthr * 2 * run.tot_atoms);
+    }
+
     // Calculate triangulated surface area for every frame
     dtinit(); // Initialize the delaunay triangulator
-    snew(areas->area, areas->nframes);
-    snew(areas->area2Dbox, areas->nframes);
-    if(flags & GTA_2D)  snew(areas->area2D, areas->nframes);
+    for(int i = 0; i < nareas; ++i) {
+        snew(areas[i].area, nframes);
+        snew(areas[i].area2Dbox, nframes);
+        snew(areas[i].time, nframes);
+        memcpy(areas[i].time, frames->time, nframes * sizeof(real));
+        if(flags & GTA_2D)  snew(areas[i].area2D, nframes);
+        if(flags & GTA_LEAFLETS) {
+            snew(areas[i].natoms_fr, nframes);
+            areas[i].leaflet = (i % 2) ? GTA_LOWER : GTA_UPPER;
+        }
+        else {
+            areas[i].leaflet = GTA_WHOLE;
+        }
+        areas[i].ntypes = ntypes;
+        if(ntypes > 0) {
+            snew(areas[i].type_area, nframes * ntypes);
+            snew(areas[i].type_natoms, nframes * ntypes);
+        }
+        if(flags & GTA_NEIGHBOURS) {
+            snew(areas[i].coord, nframes);
+            snew(areas[i].exchange, nframes);
+        }
+        if(flags & GTA_PSI6)    snew(areas[i].psi6, nframes);
+        if(flags & GTA_CURVATURE) {
+            snew(areas[i].mean_curv, nframes);
+            snew(areas[i].gauss_curv, nframes);
+        }
+        if(flags & GTA_DOMAINS) {
+            snew(areas[i].ndomains, nframes * ntypes);
+            snew(areas[i].largest, nframes * ntypes);
+            snew(areas[i].largest_area, nframes * ntypes);
+        }
+        areas[i].done = NULL;
+    }
+
+    if(!(flags & GTA_FOLLOW)) {
+        if(flags & GTA_CORRECT) // add correction for periodic bounds
+            print_log("Triangulating and correcting %d group(s) in %d frames...\n", ngroups, nframes);
+        else
+            print_log("Triangulating %d group(s) in %d frames...\n", ngroups, nframes);
+        if(flags & GTA_LEAFLETS)
+            print_log("Each group will be split into upper and lower leaflets every frame.\n");
+    }
+
+    if(flags & GTA_PRINT) {
+        open_tri_dump(out->dump_fname, nframes, nareas, &run.dump);
+    }
+    if(flags & GTA_PLY) {
+        open_ply(out->ply_fname, &run.ply);
+    }
+    if(flags & GTA_ATOMAREA) {
+        open_atom_file(out->atom_area_fname, "GTAAREA", nframes, run.tot_atoms, 1, &run.atom_area);
+    }
+    if(flags & GTA_ATOMPSI6) {
+        open_atom_file(out->atom_psi6_fname, "GTAPSI6", nframes, run.tot_atoms, 2, &run.atom_psi6);
+    }
+    if(flags & GTA_ATOMCURV) {
+        open_atom_file(out->atom_curv_fname, "GTACURV", nframes, run.tot_atoms, 5, &run.atom_curv);
+    }
+    if(flags & GTA_AREAMAP) {
+        run.map_nbins = out->map_bins * out->map_bins;
+        snew(run.map_area, run.nthr * nareas * run.map_nbins);
+        snew(run.map_count, run.nthr * nareas * run.map_nbins);
+    }
+    if(flags & GTA_THICKNESS) {
+        if(!(flags & GTA_LEAFLETS)) {
+            log_fatal(FARGS, "Leaflets are needed to calculate thickness.\n");
+        }
+        run.map_nbins = out->map_bins * out->map_bins;
+        snew(run.thick_sum, run.nthr * ngroups * run.map_nbins);
+        snew(run.thick_count, run.nthr * ngroups * run.map_nbins);
+        snew(run.thick_z, run.nthr * 2 * run.map_nbins);
+        snew(run.thick_in, run.nthr * 2 * run.map_nbins);
+    }
+    if(flags & GTA_DOMAINS) {
+        if(ntypes < 1) {
+            log_fatal(FARGS, "Lipid types are needed to find domains.\n");
+        }
+        run.max_natoms = 0;
+        for(int i = 0; i < nareas; ++i) {
+            if(areas[i].natoms > run.max_natoms)    run.max_natoms = areas[i].natoms;
+        }
+        snew(run.domain_sizes, run.nthr * nareas * ntypes * (run.max_natoms + 1));
+    }
+    if(flags & GTA_NEIGHBOURS) {
+        snew(run.nb_prev, run.nthr * nareas);
+        snew(run.nb_prev_fr, run.nthr * nareas);
+        for(int i = 0; i < run.nthr * nareas; ++i) {
+            run.nb_prev_fr[i] = -1;
+        }
+        snew(run.nb_heads, nframes * nareas);
+        snew(run.nb_tails, nframes * nareas);
+    }
+    if(flags & GTA_HIST) {
+        snew(run.hists, run.nthr * nareas * 2);
+        for(int i = 0; i < run.nthr * nareas; ++i) {
+            hist_init(&run.hists[2*i], out->hist_bins, out->hist_area_max);
+            hist_init(&run.hists[2*i+1], out->hist_bins, out->hist_edge_max);
+        }
+    }
 
-    if(flags & GTA_CORRECT) { // add correction for periodic bounds
-        print_log("Triangulating and correcting %d frames...\n", areas->nframes);
+    if(flags & GTA_ESTOP) {
+        tessellate_until_converged(frames, flags, &run, areas);
+    }
+    else {
+        // Statistics of each thread's stretch of frames, merged after tessellating
+        int nthr = run.nthr;
+        struct gta_stats *tstats;
+        snew(tstats, nthr * nareas * GTA_NSTATS);
+
+        run.cpt_done = NULL;
+        if(flags & GTA_CHECKPOINT) {
+            snew(run.cpt_done, nframes);
+            run.cpt_ndone = read_checkpoint(frames, flags, &run, areas);
+            if(run.cpt_ndone > 0) {
+                print_log("Resuming from %s, where %d of the %d frames were finished.\n", out->cpt_fname, run.cpt_ndone, nframes);
+            }
+            run.cpt_time = time(NULL);
+            snew(run.cpt_snap_done, nframes);
+            run.cpt_writing = 0;
+        }
 
-#pragma omp parallel for shared(areas,x,flags)
-        for(int fr = 0; fr < areas->nframes; ++fr) {
+        // Static scheduling gives each thread a contiguous stretch of frames, in thread order, 
+        // as needed for the blocking analysis of its statistics, and so that few neighbour exchanges span two threads
+#pragma omp parallel for schedule(static) shared(areas,frames,flags,run,tstats)
+        for(int fr = 0; fr < nframes; ++fr) {
 #if defined _OPENMP && defined GTA_DEBUG
             print_log("%d threads triangulating.\n", omp_get_num_threads());
 #endif
-            // Calculate number of edge points
-            int n_edge_x = box[fr][0][0] / espace;
-            int n_edge_y = box[fr][1][1] / espace;
-
-            // Calculate box area
-            areas->area2Dbox[fr] = box[fr][0][0] * box[fr][1][1];
-
-            // z-coordinates of particles closest to box corners
-            real bot_left = FLT_MAX, top_right = FLT_MIN, 
-                top_left = FLT_MAX, bot_right = FLT_MIN, 
-                avg_z;
-            int bot_left_ind = 0, top_right_ind = 0, top_left_ind = 0, bot_right_ind = 0;
-            
-            // Find min max coordinates for each interval
-            real *y_mins, *y_maxes, *x_mins, *x_maxes;
-            snew(y_mins, n_edge_x + 1);
-            snew(y_maxes, n_edge_x + 1);
-            snew(x_mins, n_edge_y + 1);
-            snew(x_maxes, n_edge_y + 1);
-
-            int *y_min_inds, *y_max_inds, *x_min_inds, *x_max_inds;
-            snew(y_min_inds, n_edge_x + 1);
-            snew(y_max_inds, n_edge_x + 1);
-            snew(x_min_inds, n_edge_y + 1);
-            snew(x_max_inds, n_edge_y + 1);
-
-            for(int i = 0; i <= n_edge_x; ++i)
-                y_mins[i] = FLT_MAX;
-            for(int i = 0; i <= n_edge_x; ++i)
-                y_maxes[i] = FLT_MIN;
-            for(int i = 0; i <= n_edge_y; ++i)
-                x_mins[i] = FLT_MAX;
-            for(int i = 0; i <= n_edge_y; ++i)
-                x_maxes[i] = FLT_MIN;
-
-            memset(y_min_inds, 0, sizeof(int) * (n_edge_x + 1));
-            memset(y_max_inds, 0, sizeof(int) * (n_edge_x + 1));
-            memset(x_min_inds, 0, sizeof(int) * (n_edge_y + 1));
-            memset(x_max_inds, 0, sizeof(int) * (n_edge_y + 1));
-
-            real dist, dY;
-            int x_interval, y_interval;
-            for(int j = 0; j < areas->natoms; ++j) {
-                // min and max distance from origin
-                dist = x[fr][j][XX] * x[fr][j][XX] + x[fr][j][YY] * x[fr][j][YY];
-                if(dist < bot_left) {
-                    bot_left = dist;
-                    bot_left_ind = j;
-                }
-                if(dist > top_right) {
-                    top_right = dist;
-                    top_right_ind = j;
+            struct gta_stats *st = &tstats[thread_num() * nareas * GTA_NSTATS];
+            if(st[GTA_STAT_AREA].n == 0) { // the first frame of this thread's stretch
+                for(int k = 0; k < nareas * GTA_NSTATS; ++k) {
+                    stats_init_at(&st[k], fr);
                 }
+            }
+
+            // Frames restored from the checkpoint are not tessellated again, but still count towards the statistics
+            int restored = run.cpt_done && run.cpt_done[fr];
+            if(!restored) {
+                tessellate_frame(frames, fr, flags, &run, areas);
+            }
+            for(int i = 0; i < nareas; ++i) {
+                add_frame_stats(&areas[i], fr, &st[i * GTA_NSTATS]);
+            }
 
-                // min and max distance from top left corner
-                dY = box[fr][1][1] - x[fr][j][YY];
-                dist = x[fr][j][XX] * x[fr][j][XX] + dY * dY;
-                if(dist < top_left) {
-                    top_left = dist;
-                    top_left_ind = j;
+            if(run.cpt_done && !restored) { // the finished frames are copied, and one thread at a time writes the copy
+                int write = 0;
+#pragma omp critical(gta_checkpoint)
+                {
+                    run.cpt_done[fr] = 1;
+                    ++run.cpt_ndone;
+                    if(!run.cpt_writing && difftime(time(NULL), run.cpt_time) >= 60 * out->cpt_period) {
+                        memcpy(run.cpt_snap_done, run.cpt_done, nframes);
+                        run.cpt_writing = write = 1;
+                    }
                 }
-                if(dist > bot_right) {
-                    bot_right = dist;
-                    bot_right_ind = j;
+                if(write) {
+                    write_checkpoint(frames, flags, &run, areas, run.cpt_snap_done);
+#pragma omp critical(gta_checkpoint)
+                    {
+                        run.cpt_time = time(NULL);
+                        run.cpt_writing = 0;
+                    }
                 }
+            }
+        }
 
-                // Check min max y in x interval
-                x_interval = (int)((x[fr][j][XX] / box[fr][0][0]) * n_edge_x);
+        if(run.cpt_done) {
+            if(write_checkpoint(frames, flags, &run, areas, run.cpt_done))
+                print_log("Checkpoint saved to %s\n", out->cpt_fname);
+            sfree(run.cpt_done);
+            sfree(run.cpt_snap_done);
+        }
 
-                if(x[fr][j][YY] < y_mins[x_interval]) {
-                    y_mins[x_interval] = x[fr][j][YY];
-                    y_min_inds[x_interval] = j;
+        // Merging the stretches in thread order, and so in frame order, gives the statistics of an uninterrupted pass 
+        // whatever the number of threads
+        for(int i = 0; i < nareas; ++i) {
+            for(int s = 0; s < GTA_NSTATS; ++s) {
+                stats_init(&areas[i].stats[s]);
+                for(int t = 0; t < nthr; ++t) {
+                    stats_merge(&areas[i].stats[s], &tstats[(t * nareas + i) * GTA_NSTATS + s]);
                 }
+            }
+        }
+        sfree(tstats);
+    }
+
+    sfree(run.offsets);
+    sfree(run.frame_x);
+    if(run.leaf_x) {
+        sfree(run.leaf_x);
+        sfree(run.leaf_ind);
+    }
 
-                if(x[fr][j][YY] > y_maxes[x_interval]) {
-                    y_maxes[x_interval] = x[fr][j][YY];
-                    y_max_inds[x_interval] = j;
+    if(flags & GTA_NEIGHBOURS) {
+        resolve_exchange(&run, areas);
+    }
+
+    if(flags & GTA_DOMAINS) { // sum the threads' domain size distributions
+        for(int i = 0; i < nareas; ++i) {
+            int n = areas[i].natoms + 1, stride = run.max_natoms + 1;
+            snew(areas[i].domain_sizes, ntypes * n);
+            for(int t = 0; t < run.nthr; ++t) {
+                const long *tsizes = &run.domain_sizes[(t * nareas + i) * ntypes * stride];
+                for(int k = 0; k < ntypes; ++k) {
+                    for(int j = 0; j < n; ++j) {
+                        areas[i].domain_sizes[k * n + j] += tsizes[k * stride + j];
+                    }
                 }
+            }
+        }
+        sfree(run.domain_sizes);
+    }
 
-                // Check min max x in y interval
-                y_interval = (int)((x[fr][j][YY] / box[fr][1][1]) * n_edge_y);
-                
-                if(x[fr][j][XX] < x_mins[y_interval]) {
-                    x_mins[y_interval] = x[fr][j][XX];
-                    x_min_inds[y_interval] = j;
+    if(flags & GTA_AREAMAP) { // sum the threads' histograms
+        int nthr = run.nthr;
+        int nbins = run.map_nbins;
+
+        for(int i = 0; i < nareas; ++i) {
+            struct area_map *map = &areas[i].map;
+            map->nx = out->map_bins;
+            map->ny = out->map_bins;
+            snew(map->area, nbins);
+            snew(map->count, nbins);
+            for(int t = 0; t < nthr; ++t) {
+                const real *tarea = &run.map_area[(t * nareas + i) * nbins];
+                const int *tcount = &run.map_count[(t * nareas + i) * nbins];
+                for(int b = 0; b < nbins; ++b) {
+                    map->area[b] += tarea[b];
+                    map->count[b] += tcount[b];
                 }
+            }
+
+            average_box(&areas[i], frames->box, map->box, &map->nframes); // for the bin coordinates
+        }
 
-                if(x[fr][j][XX] > x_maxes[y_interval]) {
-                    x_maxes[y_interval] = x[fr][j][XX];
-                    x_max_inds[y_interval] = j;
+        sfree(run.map_area);
+        sfree(run.map_count);
+    }
+
+    if(flags & GTA_THICKNESS) { // sum the threads' maps into the upper leaflet of each group
+        int nbins = run.map_nbins;
+
+        for(int g = 0; g < ngroups; ++g) {
+            struct thickness_map *map = &areas[g * nsurf].thick;
+            map->nx = out->map_bins;
+            map->ny = out->map_bins;
+            snew(map->thickness, nbins);
+            snew(map->count, nbins);
+            for(int t = 0; t < run.nthr; ++t) {
+                const real *tsum = &run.thick_sum[(t * ngroups + g) * nbins];
+                const int *tcount = &run.thick_count[(t * ngroups + g) * nbins];
+                for(int b = 0; b < nbins; ++b) {
+                    map->thickness[b] += tsum[b];
+                    map->count[b] += tcount[b];
                 }
             }
+            for(int b = 0; b < nbins; ++b) {
+                if(map->count[b] > 0)   map->thickness[b] /= map->count[b];
+            }
 
-            sfree(y_mins);
-            sfree(y_maxes);
-            sfree(x_mins);
-            sfree(x_maxes);
-
-            avg_z = ( x[fr][bot_left_ind][ZZ] 
-                    + x[fr][top_right_ind][ZZ] 
-                    + x[fr][top_left_ind][ZZ] 
-                    + x[fr][bot_right_ind][ZZ]) / 4.0;
-
-            // add edge and corner points
-
-            srenew(x[fr], areas->natoms + 2 * (n_edge_x + 1) + 2 * (n_edge_y + 1));
-            int n = areas->natoms;
-
-            // Add corner points
-            x[fr][n][XX]    = 0;
-            x[fr][n][YY]    = 0;
-            x[fr][n++][ZZ]  = avg_z;
-
-            x[fr][n][XX]    = box[fr][0][0];
-            x[fr][n][YY]    = 0;
-            x[fr][n++][ZZ]  = avg_z;
-
-            x[fr][n][XX]    = box[fr][0][0];
-            x[fr][n][YY]    = box[fr][1][1];
-            x[fr][n++][ZZ]  = avg_z;
-
-            x[fr][n][XX]    = 0;
-            x[fr][n][YY]    = box[fr][1][1];
-            x[fr][n++][ZZ]  = avg_z;
-
-            // Add edge points
-            real dist1, dist2;
-            for(int j = 0; j < n_edge_x; ++j) {
-                // Bottom edge
-                x[fr][n][XX] = j * espace + espace / 2; // Go to middle of interval
-                x[fr][n][YY] = 0;
-                // edge Z coord is distance-from-edge-weighted average between the Zs of the two points closest to the two edges of this axis
-                dist1 = x[fr][y_min_inds[j]][YY];
-                dist2 = box[fr][1][1] - x[fr][y_max_inds[j]][YY];
-                dist = dist1 + dist2;
-                avg_z = x[fr][y_min_inds[j]][ZZ] - (dist1/dist)*(x[fr][y_min_inds[j]][ZZ]) 
-                      + x[fr][y_max_inds[j]][ZZ] - (dist2/dist)*(x[fr][y_max_inds[j]][ZZ]);
-                x[fr][n++][ZZ] = avg_z;
-
-                // Top edge
-                x[fr][n][XX] = j * espace + espace / 2;
-                x[fr][n][YY] = box[fr][1][1];
-                x[fr][n++][ZZ] = avg_z;
-            }
-
-            for(int j = 0; j < n_edge_y; ++j) {
-                // Left edge
-                x[fr][n][XX] = 0;
-                x[fr][n][YY] = j * espace + espace / 2;
-                
-                dist1 = x[fr][x_min_inds[j]][XX];
-                dist2 = box[fr][0][0] - x[fr][x_max_inds[j]][XX];
-                dist = dist1 + dist2;
-                avg_z = x[fr][x_min_inds[j]][ZZ] - (dist1/dist)*(x[fr][x_min_inds[j]][ZZ])
-                      + x[fr][x_max_inds[j]][ZZ] - (dist2/dist)*(x[fr][x_max_inds[j]][ZZ]);
-                x[fr][n++][ZZ] = avg_z;
-
-                // Right edge
-                x[fr][n][XX] = box[fr][0][0];
-                x[fr][n][YY] = j * espace + espace / 2;
-                x[fr][n++][ZZ] = avg_z;
-            }
-
-            sfree(y_min_inds);
-            sfree(y_max_inds);
-            sfree(x_min_inds);
-            sfree(x_max_inds);
-
-// #ifdef GTA_DEBUG
-//             FILE *f = fopen("points.txt", "w");
-
-//             for(int j = 0; j < n; ++j) {
-//                 fprintf(f, "%d: %f\t%f\t%f\n", j, x[fr][j][XX], x[fr][j][YY], x[fr][j][ZZ]);
-//             }
-
-//             fclose(f);
-
-//             print_log("Points saved to points.txt for debugging.\n");
-//             exit(0);
-// #endif
-
-            // Calculate area including added edge and corner points
-            real *a2D = NULL;
-            if(flags & GTA_2D)  a2D = &(areas->area2D[fr]);
-            delaunay_surface_area(x[fr], box[fr], n, flags, a2D, &(areas->area[fr]));
-        }
-    }
-    else { // triangulate without correction for periodic bounds
-        print_log("Triangulating %d frames...\n", areas->nframes);
-
-#pragma omp parallel for shared(areas,x,flags)
-        for(int fr = 0; fr < areas->nframes; ++fr) {
-#if defined _OPENMP && defined GTA_DEBUG
-            print_log("%d threads triangulating.\n", omp_get_num_threads());
-#endif
-            
-            // BOX PRINT
-            // if(fr == 0) {
-            //     printf("%f\t%f\t%f\n%f\t%f\t%f\n%f\t%f\t%f\n",
-            //         box[fr][0][0], box[fr][0][1], box[fr][0][2], 
-            //         box[fr][1][0], box[fr][1][1], box[fr][1][2],
-            //         box[fr][2][0], box[fr][2][1], box[fr][2][2]);
-            // }
+            average_box(&areas[g * nsurf], frames->box, map->box, &map->nframes);
+        }
 
-            // 2D area of box
-            areas->area2Dbox[fr] = box[fr][0][0] * box[fr][1][1];
+        sfree(run.thick_sum);
+        sfree(run.thick_count);
+        sfree(run.thick_z);
+        sfree(run.thick_in);
+    }
 
-            real *a2D = NULL;
-            if(flags & GTA_2D)  a2D = &(areas->area2D[fr]);
-            delaunay_surface_area(x[fr], box[fr], areas->natoms, flags, a2D, &(areas->area[fr]));
+    if(flags & GTA_HIST) { // merge the threads' histograms
+        for(int i = 0; i < nareas; ++i) {
+            hist_init(&areas[i].tri_hist, out->hist_bins, out->hist_area_max);
+            hist_init(&areas[i].edge_hist, out->hist_bins, out->hist_edge_max);
+            for(int t = 0; t < run.nthr; ++t) {
+                hist_merge(&areas[i].tri_hist, &run.hists[2 * (t * nareas + i)]);
+                hist_merge(&areas[i].edge_hist, &run.hists[2 * (t * nareas + i) + 1]);
+            }
+        }
+        for(int i = 0; i < 2 * run.nthr * nareas; ++i) {
+            hist_free(&run.hists[i]);
         }
+        sfree(run.hists);
+    }
+
+    // K_A = kT <A> / <dA^2> from the fluctuations of the box area
+    real temp = out ? out->temp : 0;
+    for(int i = 0; i < nareas; ++i) {
+        const struct gta_stats *box_stats = &areas[i].stats[GTA_STAT_BOX];
+        double var = stats_var(box_stats);
+        areas[i].area_modulus = (temp > 0 && var > 0) ? GTA_BOLTZ * temp * box_stats->mean / var : 0;
+    }
+
+    if(flags & GTA_PRINT) {
+        close_tri_dump(&run.dump);
+        print_log("Triangulations saved to %s\n", out->dump_fname);
+    }
+    if(flags & GTA_PLY) {
+        close_ply(&run.ply);
+        print_log("Triangulated mesh saved to %s\n", out->ply_fname);
+    }
+    if(flags & GTA_ATOMAREA) {
+        close_atom_file(&run.atom_area);
+        print_log("Per-atom areas saved to %s\n", out->atom_area_fname);
+    }
+    if(flags & GTA_ATOMPSI6) {
+        close_atom_file(&run.atom_psi6);
+        print_log("Per-atom hexatic order parameters saved to %s\n", out->atom_psi6_fname);
+    }
+    if(flags & GTA_ATOMCURV) {
+        close_atom_file(&run.atom_curv);
+        print_log("Per-atom normals and curvatures saved to %s\n", out->atom_curv_fname);
     }
 
 #ifdef GTA_BENCH
@@ -329,176 +902,1719 @@ void delaunay_tessellate(rvec **x,
 }
 
 
-void delaunay_surface_area(const rvec *x,
-                           matrix box, 
-                           int natoms, 
-                           unsigned char flags,
-                           real *a2D,
-                           real *a3D) {
-    static int iter = 0;
+static void tessellate_frame(const struct gta_frames *frames, 
+                             int fr, 
+                             unsigned long flags, 
+                             struct tri_run *run, 
+                             struct tri_area *areas) {
+    int nsurf = run->nsurf;
+    rvec *box = frames->box[fr];
+    int thr = thread_num();
+    rvec *x = &run->frame_x[thr * run->tot_atoms]; // coordinates of this frame, gathered from the store's planes
+    frames_get(frames, fr, x);
+
+    struct atom_frame af = {NULL}; // per-atom values of every atom in this frame
+    if(flags & GTA_ATOMAREA)    snew(af.area, run->tot_atoms);
+    if(flags & GTA_ATOMPSI6)    snew(af.psi6, 2 * run->tot_atoms);
+    if(flags & GTA_ATOMCURV)    snew(af.curv, 5 * run->tot_atoms);
+
+    for(int g = 0; g < run->ngroups; ++g) {
+        struct tri_area *ga = &areas[g * nsurf];
+        const rvec *gx = x + run->offsets[g];
+        struct atom_frame gaf; // per-atom values of this group
+        gaf.area = af.area ? af.area + run->offsets[g] : NULL;
+        gaf.psi6 = af.psi6 ? af.psi6 + 2 * run->offsets[g] : NULL;
+        gaf.curv = af.curv ? af.curv + 5 * run->offsets[g] : NULL;
+
+        if(flags & GTA_LEAFLETS) {
+            rvec *xu = &run->leaf_x[2 * thr * run->tot_atoms], *xl = xu + run->tot_atoms;
+            int *iu = &run->leaf_ind[2 * thr * run->tot_atoms], *il = iu + run->tot_atoms;
+
+            split_leaflets(gx, ga->natoms, box, 
+                xu, iu, &(ga[0].natoms_fr[fr]), xl, il, &(ga[1].natoms_fr[fr]));
+
+            tessellate_surface(xu, iu, ga[0].natoms_fr[fr], box, run->espace, flags, fr, g * nsurf, run, &ga[0], &gaf);
+            tessellate_surface(xl, il, ga[1].natoms_fr[fr], box, run->espace, flags, fr, g * nsurf + 1, run, &ga[1], &gaf);
+
+            if(flags & GTA_THICKNESS) { // difference of the leaflets' heights at every bin within both
+                int nbins = run->map_nbins;
+                const real *zu = &run->thick_z[2 * thr * nbins], *zl = zu + nbins;
+                const int *inu = &run->thick_in[2 * thr * nbins], *inl = inu + nbins;
+                real *tsum = &run->thick_sum[(thr * run->ngroups + g) * nbins];
+                int *tcount = &run->thick_count[(thr * run->ngroups + g) * nbins];
+
+                for(int b = 0; b < nbins; ++b) {
+                    if(inu[b] && inl[b]) {
+                        tsum[b] += zu[b] - zl[b];
+                        ++tcount[b];
+                    }
+                }
+            }
+        }
+        else {
+            tessellate_surface(gx, NULL, ga->natoms, box, run->espace, flags, fr, g, run, ga, &gaf);
+        }
+    }
 
-    struct dTriangulation tri;
-    ++iter;
+    if(af.area) {
+        write_atom_frame(&run->atom_area, fr, af.area);
+        sfree(af.area);
+    }
+    if(af.psi6) {
+        write_atom_frame(&run->atom_psi6, fr, af.psi6);
+        sfree(af.psi6);
+    }
+    if(af.curv) {
+        write_atom_frame(&run->atom_curv, fr, af.curv);
+        sfree(af.curv);
+    }
+}
 
-    // Input initialization
-    snew(tri.points, 2 * natoms);
-    tri.npoints = natoms;
 
-    for(int i = 0; i < natoms; ++i) {
-        tri.points[2*i] = x[i][XX];
-        tri.points[2*i+1] = x[i][YY];
+static void tessellate_until_converged(const struct gta_frames *frames, 
+                                       unsigned long flags, 
+                                       struct tri_run *run, 
+                                       struct tri_area *areas) {
+    int nframes = areas[0].nframes;
+    int nareas = run->nsurf * run->ngroups;
+    real tol = run->out->tol;
+    int nthr = run->nthr;
+
+    int *order; // Order in which the frames are tessellated
+    snew(order, nframes);
+    if(run->out->order == GTA_ORDER_RANDOM) {
+        // Fisher-Yates shuffle with a xorshift64* generator
+        uint64_t state = run->out->seed ? run->out->seed : 1;
+        for(int i = 0; i < nframes; ++i) {
+            order[i] = i;
+        }
+        for(int i = nframes - 1; i > 0; --i) {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            int j = (state * 2685821657736338717ULL) % (uint64_t)(i + 1);
+            int tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+    }
+    else {
+        // Passes over the trajectory with halving strides, each pass taking the frames between those of the previous ones
+        int stride = 1, n = 0;
+        while(stride * 2 * STATS_MINBLOCKS < nframes) {
+            stride *= 2;
+        }
+        for(int fr = 0; fr < nframes; fr += stride) {
+            order[n++] = fr;
+        }
+        for(stride /= 2; stride >= 1; stride /= 2) {
+            for(int fr = stride; fr < nframes; fr += 2 * stride) {
+                order[n++] = fr;
+            }
+        }
     }
 
-    // triangulate
-    dtriangulate(&tri);
-
-    if(flags & GTA_PRINT) { // print triangle data to files that can be viewed with triangle's 'showme' program
-        char fname1[50], fname2[50];
-        sprintf(fname1, "triangles%d.node", iter);
-        sprintf(fname2, "triangles%d.ele", iter);
-        print_dtrifiles(&tri, fname1, fname2);
+    unsigned char *done; // Whether each frame has been tessellated, shared by all of the tri_area structs
+    snew(done, nframes);
+    for(int i = 0; i < nareas; ++i) {
+        areas[i].done = done;
     }
 
-    // TODO: Add flag check!
-    // print_triangulation3D(x, box, &tri, iter - 1, "tri3D.pdb");
+    print_log("Tessellating frames in %s order until the standard error of the area per particle is below %f...\n", 
+        run->out->order == GTA_ORDER_RANDOM ? "random" : "strided", tol);
 
-    sfree(tri.points);
+    int ndone = 0, converged = 0;
+    double max_sem = 0;
+    while(ndone < nframes && !converged) {
+        // Batches grow with the number of tessellated frames, so that checking costs little and overshoots by at most an eighth
+        int batch = ndone / 8;
+        if(batch < 4 * nthr)    batch = 4 * nthr;
+        if(ndone == 0)          batch = 2 * STATS_MINBLOCKS;
+        if(batch > nframes - ndone)     batch = nframes - ndone;
 
-    // calculate surface area of triangles
-    if(a2D) {
-        if(a3D) {
-            *a2D = 0;
-            *a3D = 0;
-            rvec a, b, c;
-            for(int i = 0; i < tri.ntriangles; ++i) {
-                copy_rvec(x[tri.triangles[3*i]], a);
-                copy_rvec(x[tri.triangles[3*i + 1]], b);
-                copy_rvec(x[tri.triangles[3*i + 2]], c);
+        frames_load(frames, order + ndone, batch); // if the frames are decoded as needed
 
-                (*a3D) += area_tri(a, b, c);
+#pragma omp parallel for schedule(dynamic) shared(areas,frames,flags,run,order)
+        for(int k = ndone; k < ndone + batch; ++k) {
+            tessellate_frame(frames, order[k], flags, run, areas);
+        }
 
-                a[ZZ] = 0;
-                b[ZZ] = 0;
-                c[ZZ] = 0;
+        for(int k = ndone; k < ndone + batch; ++k) {
+            done[order[k]] = 1;
+        }
+        ndone += batch;
 
-                (*a2D) += area_tri(a, b, c);
+        // The statistics of the tessellated frames in time order, so that blocking accounts for their correlation
+        max_sem = 0;
+        for(int i = 0; i < nareas; ++i) {
+            for(int s = 0; s < GTA_NSTATS; ++s) {
+                stats_init(&areas[i].stats[s]);
+            }
+            for(int fr = 0; fr < nframes; ++fr) {
+                if(done[fr])    add_frame_stats(&areas[i], fr, areas[i].stats);
             }
+
+            double sem = stats_sem(&areas[i].stats[GTA_STAT_APL]);
+            if(sem > max_sem)   max_sem = sem;
         }
-        else {
-            *a2D = 0;
-            rvec a, b, c;
-            for(int i = 0; i < tri.ntriangles; ++i) {
-                copy_rvec(x[tri.triangles[3*i]], a);
-                copy_rvec(x[tri.triangles[3*i + 1]], b);
-                copy_rvec(x[tri.triangles[3*i + 2]], c);
+#ifdef GTA_DEBUG
+        print_log("%d frames tessellated, standard error %f\n", ndone, max_sem);
+#endif
 
-                a[ZZ] = 0;
-                b[ZZ] = 0;
-                c[ZZ] = 0;
+        converged = ndone >= 2 * STATS_MINBLOCKS && max_sem < tol;
+    }
 
-                (*a2D) += area_tri(a, b, c);
-            }
+    if(converged) {
+        print_log("Standard error of the area per particle %f reached after %d of %d frames.\n", max_sem, ndone, nframes);
+        for(int i = 1; i < nareas; ++i) { // each struct gets its own copy to free
+            snew(areas[i].done, nframes);
+            memcpy(areas[i].done, done, nframes);
         }
     }
-    else if(a3D) {
-        *a3D = 0;
-        for(int i = 0; i < tri.ntriangles; ++i) {
-            (*a3D) += area_tri( x[tri.triangles[3*i]], 
-                                x[tri.triangles[3*i + 1]], 
-                                x[tri.triangles[3*i + 2]]);
+    else {
+        print_log("Standard error of the area per particle is %f after all %d frames, above the tolerance %f.\n", 
+            max_sem, nframes, tol);
+        for(int i = 0; i < nareas; ++i) { // all frames were tessellated
+            areas[i].done = NULL;
         }
+        sfree(done);
     }
 
-    free(tri.triangles);
+    sfree(order);
 }
 
 
-void print_triangulation3D(const rvec *x, 
-                           matrix box, 
-                           const struct dTriangulation *tri, 
-                           int modelnum, 
-                           const char *fname) {
-    FILE *pdb = fopen(fname, "a");
+static void add_frame_stats(const struct tri_area *ga, int fr, struct gta_stats *st) {
+    stats_add(&st[GTA_STAT_AREA], ga->area[fr]);
+    if(ga->area2D)  stats_add(&st[GTA_STAT_AREA2D], ga->area2D[fr]);
+    int natoms = ga->natoms_fr ? ga->natoms_fr[fr] : ga->natoms;
+    stats_add(&st[GTA_STAT_APL], natoms > 0 ? ga->area[fr] / natoms : 0);
+    stats_add(&st[GTA_STAT_BOX], ga->area2Dbox[fr]);
+}
+
+
+static void tessellate_surface(const rvec *x, 
+                               const int *ind, 
+                               int natoms, 
+                               matrix box, 
+                               real espace, 
+                               unsigned long flags, 
+                               int fr, 
+                               int surf, 
+                               struct tri_run *run, 
+                               struct tri_area *ga, 
+                               struct atom_frame *af) {
+    const rvec *xs = x; // the triangulated points
+    rvec *xc = NULL;
+    int npoints = natoms;
+    real *aa = NULL; // area of each atom of this surface
+    struct dTriangulation tri;
+
+    // 2D area of box
+    ga->area2Dbox[fr] = area_box2D(box);
 
-    if(box) {
-        fprintf(pdb, "CRYST1%9.3f%9.3f%9.3f%7.2f%7.2f%7.2f P 1           1\n", 
-        box[0][0] * 10, box[1][1] * 10, box[2][2] * 10, 90.0, 90.0, 90.0);
+    real *a2D = NULL;
+    if(flags & GTA_2D)  a2D = &(ga->area2D[fr]);
+
+    if(natoms < MINPOINTS) { // eg an empty leaflet: the areas and per-atom values of the surface stay 0
+#pragma omp critical(gta_small_surface)
+        {
+            if(!run->warned_small) {
+                print_log("\nWARNING: Surface %d of frame %d has %d atom(s), too few to triangulate. "
+                    "The areas of such surfaces are written as 0.\n", surf, fr, natoms);
+                run->warned_small = 1;
+            }
+        }
+        ga->area[fr] = 0;
+        if(a2D)     *a2D = 0;
+        if(flags & GTA_NEIGHBOURS) { // no neighbours, so that the exchange with the next frame is still found
+            neighbour_frame(NULL, 0, ind, natoms, fr, surf, run, ga);
+        }
+        if(flags & GTA_PSI6)    ga->psi6[fr] = 0;
+        if(flags & GTA_CURVATURE) {
+            ga->mean_curv[fr] = 0;
+            ga->gauss_curv[fr] = 0;
+        }
+        if(flags & GTA_DOMAINS) { // every atom is a domain of its own
+            real aa0[MINPOINTS] = {0};
+            long *sizes = &run->domain_sizes[(thread_num() * run->nsurf * run->ngroups + surf) * ga->ntypes * (run->max_natoms + 1)];
+            find_domains(NULL, 0, ind, natoms, aa0, run->out->types[surf / run->nsurf], fr, ga, sizes, run->max_natoms + 1);
+        }
+        if(flags & GTA_THICKNESS) { // no bin lies within this leaflet
+            int nbins = run->map_nbins, k = (2 * thread_num() + ga->leaflet - GTA_UPPER) * nbins;
+            memset(&run->thick_in[k], 0, nbins * sizeof(int));
+        }
+        return;
     }
 
-    fprintf(pdb, "MODEL %4d\n", modelnum);
-    for(int i = 0; i < tri->npoints; ++i) {
-        fprintf(pdb, "ATOM  %5d                   %8.3f%8.3f%8.3f\n", 
-            i + 1, x[i][XX] * 10, x[i][YY] * 10, x[i][ZZ] * 10); // convert nm to angstroms
+    if(flags & GTA_CORRECT) { // add edge and corner points to correct for periodic bounds
+        npoints = add_edge_points(x, natoms, box, espace, &xc);
+        xs = xc;
     }
 
-    // fprintf(pdb, "TER   \n");
+    delaunay_triangulate(xs, npoints, &tri);
 
-    for(int i = 0; i < tri->ntriangles; ++i) {
-        fprintf(pdb, "CONECT%5d%5d%5d\n", 
-            tri->triangles[3*i] + 1, tri->triangles[3*i+1] + 1, tri->triangles[3*i+2] + 1);
-        fprintf(pdb, "CONECT%5d%5d\n", 
-            tri->triangles[3*i+1] + 1, tri->triangles[3*i+2] + 1);
+    if(flags & GTA_PRINT) {
+        write_tri_dump(&run->dump, fr, surf, xs, &tri);
     }
 
-    fprintf(pdb, "ENDMDL\n");
+    if(flags & GTA_PLY) {
+        write_ply(&run->ply, fr, surf, xs, &tri);
+    }
 
-    fclose(pdb);
-}
+    if(af->area || ga->type_area || (flags & (GTA_AREAMAP | GTA_DOMAINS))) {
+        snew(aa, natoms);
+    }
 
-void print_areas(const char *fname, const struct tri_area *areas) {
-    FILE *f = fopen(fname, "w");
-    real sum = 0;
+    struct gta_hist *hists = NULL; // this thread's histograms of this surface
+    if(flags & GTA_HIST) {
+        hists = &run->hists[2 * (thread_num() * run->nsurf * run->ngroups + surf)];
+    }
+
+    tri_surface_area(xs, &tri, natoms, a2D, &(ga->area[fr]), aa, hists);
+
+    // Edges between atoms (not edge correction points), shared by the analyses below
+    uint64_t *edges = NULL;
+    int nedges = 0;
+    if(flags & (GTA_HIST | GTA_NEIGHBOURS | GTA_PSI6 | GTA_DOMAINS)) {
+        nedges = atom_edges(&tri, natoms, &edges);
+    }
+
+    if(hists) { // lengths of the edges between atoms
+        for(int i = 0; i < nedges; ++i) {
+            hist_add(&hists[1], sqrt(distance2(xs[dtedge_a(edges[i])], xs[dtedge_b(edges[i])])));
+        }
+    }
+
+    if(flags & GTA_NEIGHBOURS) {
+        neighbour_frame(edges, nedges, ind, natoms, fr, surf, run, ga);
+    }
+
+    if(flags & GTA_PSI6) {
+        ga->psi6[fr] = hexatic_order(xs, natoms, edges, nedges, ind, af->psi6);
+    }
+
+    if(flags & GTA_CURVATURE) {
+        surface_curvature(xs, &tri, natoms, ind, fr, ga, af->curv);
+    }
+
+    if(flags & GTA_DOMAINS) {
+        long *sizes = &run->domain_sizes[(thread_num() * run->nsurf * run->ngroups + surf) * ga->ntypes * (run->max_natoms + 1)];
+        find_domains(edges, nedges, ind, natoms, aa, run->out->types[surf / run->nsurf], fr, ga, sizes, run->max_natoms + 1);
+    }
+
+    if(af->area) { // store atom areas at the atoms' places in the group
+        for(int i = 0; i < natoms; ++i) {
+            af->area[ind ? ind[i] : i] = aa[i];
+        }
+    }
 
-    if(areas->area2D) {
-        fprintf(f, "# FRAME\tAREA\t2DAREA\tBOX-AREA\t\"\"/PARTICLE\n");
-        for(int i = 0; i < areas->nframes; ++i) {
-            fprintf(f, "%d\t%f\t%f\t%f\t%f\t%f\t%f\n", i, areas->area[i], areas->area2D[i], areas->area2Dbox[i], 
-                areas->area[i] / areas->natoms, areas->area2D[i] / areas->natoms, areas->area2Dbox[i] / areas->natoms);
-            sum += areas->area[i];
+    if(ga->type_area) { // aggregate atom areas by lipid type
+        const int *types = run->out->types[surf / run->nsurf];
+        real *type_area = &(ga->type_area[fr * ga->ntypes]);
+        int *type_natoms = &(ga->type_natoms[fr * ga->ntypes]);
+        int t;
+
+        for(int i = 0; i < natoms; ++i) {
+            t = types[ind ? ind[i] : i];
+            if(t >= 0) {
+                type_area[t] += aa[i];
+                ++type_natoms[t];
+            }
         }
     }
+
+    if(flags & GTA_THICKNESS) { // heights of this leaflet at the thickness map bins
+        int nbins = run->map_nbins, k = (2 * thread_num() + ga->leaflet - GTA_UPPER) * nbins;
+        rvec *q;
+        snew(q, nbins);
+        map_nodes(box, run->out->map_bins, run->out->map_bins, q);
+        tri_surface_heights(xs, npoints, &tri, q, nbins, &run->thick_z[k], &run->thick_in[k]);
+        sfree(q);
+    }
+
+    if(flags & GTA_AREAMAP) { // add atom areas to this thread's histogram
+        int k = (thread_num() * run->nsurf * run->ngroups + surf) * run->map_nbins;
+        splat_areas(x, aa, natoms, box, run->out->map_bins, run->out->map_bins, 
+            &run->map_area[k], &run->map_count[k]);
+    }
+
+    free(tri.triangles);
+    if(edges)   free(edges);
+    if(xc)  sfree(xc);
+    if(aa)  sfree(aa);
+}
+
+
+static int atom_edges(const struct dTriangulation *tri, int natoms, uint64_t **edges) {
+    int nedges = dtedges(tri, edges), n = 0;
+
+    for(int i = 0; i < nedges; ++i) {
+        if(dtedge_b((*edges)[i]) < natoms)  (*edges)[n++] = (*edges)[i]; // the larger index is an atom, so both are
+    }
+
+    return n;
+}
+
+
+static void neighbour_frame(const uint64_t *edges, 
+                            int nedges, 
+                            const int *ind, 
+                            int natoms, 
+                            int fr, 
+                            int surf, 
+                            struct tri_run *run, 
+                            struct tri_area *ga) {
+    int k = thread_num() * run->nsurf * run->ngroups + surf;
+    int nareas = run->nsurf * run->ngroups;
+    struct edge_set cur, *prev = &run->nb_prev[k];
+
+    ga->coord[fr] = natoms > 0 ? 2.0 * nedges / natoms : 0;
+
+    // Keys of the atoms' indices in the group. ind is increasing, so the keys stay sorted.
+    cur.n = nedges;
+    snew(cur.keys, nedges + 1);
+    for(int i = 0; i < nedges; ++i) {
+        int a = dtedge_a(edges[i]), b = dtedge_b(edges[i]);
+        cur.keys[i] = ind ? dtedge_key(ind[a], ind[b]) : edges[i];
+    }
+
+    if(prev->keys && run->nb_prev_fr[k] == fr - 1) {
+        ga->exchange[fr] = prev->n > 0 ? 1 - (real)count_common(prev->keys, prev->n, cur.keys, cur.n) / prev->n : 0;
+        sfree(prev->keys);
+    }
     else {
-        fprintf(f, "# FRAME\tAREA\tBOX-AREA\t\"\"/PARTICLE\n");
-        for(int i = 0; i < areas->nframes; ++i) {
-            fprintf(f, "%d\t%f\t%f\t%f\t%f\n", i, areas->area[i], areas->area2Dbox[i], 
-                areas->area[i] / areas->natoms, areas->area2Dbox[i] / areas->natoms);
-            sum += areas->area[i];
+        ga->exchange[fr] = -1;
+        if(fr > 0) { // compare with the previous frame later
+            struct edge_set *head = &run->nb_heads[fr * nareas + surf];
+            head->n = cur.n;
+            snew(head->keys, cur.n + 1);
+            memcpy(head->keys, cur.keys, cur.n * sizeof(uint64_t));
+        }
+        if(prev->keys) { // the next frame of the previous one was not tessellated by this thread
+            run->nb_tails[run->nb_prev_fr[k] * nareas + surf] = *prev;
+        }
+    }
+
+    *prev = cur;
+    run->nb_prev_fr[k] = fr;
+}
+
+
+static void resolve_exchange(struct tri_run *run, struct tri_area *areas) {
+    int nareas = run->nsurf * run->ngroups;
+    int nframes = areas[0].nframes;
+
+    // The last frames of the threads are tails too
+    for(int k = 0; k < run->nthr * nareas; ++k) {
+        if(run->nb_prev[k].keys) {
+            run->nb_tails[run->nb_prev_fr[k] * nareas + k % nareas] = run->nb_prev[k];
+        }
+    }
+
+    for(int fr = 1; fr < nframes; ++fr) {
+        for(int i = 0; i < nareas; ++i) {
+            const struct edge_set *head = &run->nb_heads[fr * nareas + i];
+            const struct edge_set *tail = &run->nb_tails[(fr - 1) * nareas + i];
+            if(head->keys && tail->keys) {
+                areas[i].exchange[fr] = tail->n > 0 ? 1 - (real)count_common(tail->keys, tail->n, head->keys, head->n) / tail->n : 0;
+            }
+        }
+    }
+
+    for(int i = 0; i < nframes * nareas; ++i) {
+        if(run->nb_heads[i].keys)   sfree(run->nb_heads[i].keys);
+        if(run->nb_tails[i].keys)   sfree(run->nb_tails[i].keys);
+    }
+    sfree(run->nb_heads);
+    sfree(run->nb_tails);
+    sfree(run->nb_prev);
+    sfree(run->nb_prev_fr);
+}
+
+
+static int count_common(const uint64_t *a, int na, const uint64_t *b, int nb) {
+    int i = 0, j = 0, n = 0;
+
+    while(i < na && j < nb) {
+        if(a[i] < b[j])         ++i;
+        else if(a[i] > b[j])    ++j;
+        else {
+            ++n;
+            ++i;
+            ++j;
+        }
+    }
+
+    return n;
+}
+
+
+static real hexatic_order(const rvec *x, 
+                          int natoms, 
+                          const uint64_t *edges, 
+                          int nedges, 
+                          const int *ind, 
+                          real *atom_psi6) {
+    real *re, *im, u, v, r, re3, im3, sum = 0;
+    int *nnb, a, b, n = 0;
+    snew(re, natoms);
+    snew(im, natoms);
+    snew(nnb, natoms);
+
+    for(int i = 0; i < nedges; ++i) {
+        a = dtedge_a(edges[i]);
+        b = dtedge_b(edges[i]);
+
+        // exp(6i theta) as the sixth power of the bond's unit vector in the complex plane. 
+        // It is the same for theta + pi, so the bond adds the same term to both of its atoms.
+        u = x[b][XX] - x[a][XX];
+        v = x[b][YY] - x[a][YY];
+        r = sqrt(u * u + v * v);
+        if(r == 0)  continue;
+        u /= r;
+        v /= r;
+        re3 = u * u * u - 3 * u * v * v;
+        im3 = 3 * u * u * v - v * v * v;
+
+        re[a] += re3 * re3 - im3 * im3;
+        im[a] += 2 * re3 * im3;
+        re[b] += re3 * re3 - im3 * im3;
+        im[b] += 2 * re3 * im3;
+        ++nnb[a];
+        ++nnb[b];
+    }
+
+    for(int i = 0; i < natoms; ++i) {
+        if(nnb[i] > 0) {
+            re[i] /= nnb[i];
+            im[i] /= nnb[i];
+            sum += sqrt(re[i] * re[i] + im[i] * im[i]);
+            ++n;
+        }
+        if(atom_psi6) {
+            int k = ind ? ind[i] : i;
+            atom_psi6[2*k] = re[i];
+            atom_psi6[2*k+1] = im[i];
+        }
+    }
+
+    sfree(re);
+    sfree(im);
+    sfree(nnb);
+
+    return n > 0 ? sum / n : 0;
+}
+
+
+static void find_domains(const uint64_t *edges, 
+                         int nedges, 
+                         const int *ind, 
+                         int natoms, 
+                         const real *aa, 
+                         const int *types, 
+                         int fr, 
+                         struct tri_area *ga, 
+                         long *sizes, 
+                         int stride) {
+    int ntypes = ga->ntypes;
+    int *parent, *size, *type;
+    real *area;
+    snew(parent, natoms);
+    snew(size, natoms);
+    snew(type, natoms);
+    snew(area, natoms);
+
+    for(int i = 0; i < natoms; ++i) {
+        parent[i] = i;
+        size[i] = 1;
+        type[i] = types[ind ? ind[i] : i];
+    }
+
+    // join the atoms of each edge between atoms of the same type, attaching the smaller set to the larger
+    for(int i = 0; i < nedges; ++i) {
+        int a = dtedge_a(edges[i]), b = dtedge_b(edges[i]);
+        if(type[a] < 0 || type[a] != type[b])   continue;
+
+        a = uf_find(parent, a);
+        b = uf_find(parent, b);
+        if(a == b)  continue;
+        if(size[a] < size[b]) {
+            int tmp = a;
+            a = b;
+            b = tmp;
+        }
+        parent[b] = a;
+        size[a] += size[b];
+    }
+
+    // sum the areas of the domains at their roots
+    for(int i = 0; i < natoms; ++i) {
+        if(type[i] >= 0)    area[uf_find(parent, i)] += aa[i];
+    }
+
+    int *ndomains = &ga->ndomains[fr * ntypes], *largest = &ga->largest[fr * ntypes];
+    real *largest_area = &ga->largest_area[fr * ntypes];
+    for(int i = 0; i < natoms; ++i) {
+        int t = type[i];
+        if(t < 0 || parent[i] != i)     continue; // only roots
+
+        ++ndomains[t];
+        ++sizes[t * stride + size[i]];
+        if(size[i] > largest[t] || (size[i] == largest[t] && area[i] > largest_area[t])) {
+            largest[t] = size[i];
+            largest_area[t] = area[i];
+        }
+    }
+
+    sfree(parent);
+    sfree(size);
+    sfree(type);
+    sfree(area);
+}
+
+
+static void surface_curvature(const rvec *x, 
+                              const struct dTriangulation *tri, 
+                              int natoms, 
+                              const int *ind, 
+                              int fr, 
+                              struct tri_area *ga, 
+                              real *atom_curv) {
+    rvec *normals;
+    real *mean, *gauss, sum_mean = 0, sum_gauss = 0;
+    int *interior, n = 0;
+    snew(normals, natoms);
+    snew(mean, natoms);
+    snew(gauss, natoms);
+    snew(interior, natoms);
+
+    tri_surface_curvature(x, tri, natoms, normals, mean, gauss, interior);
+
+    for(int i = 0; i < natoms; ++i) {
+        if(interior[i]) {
+            sum_mean += mean[i];
+            sum_gauss += gauss[i];
+            ++n;
+        }
+        if(atom_curv) {
+            real *c = &atom_curv[5 * (ind ? ind[i] : i)];
+            c[0] = normals[i][XX];
+            c[1] = normals[i][YY];
+            c[2] = normals[i][ZZ];
+            c[3] = mean[i];
+            c[4] = gauss[i];
+        }
+    }
+
+    ga->mean_curv[fr] = n > 0 ? sum_mean / n : 0;
+    ga->gauss_curv[fr] = n > 0 ? sum_gauss / n : 0;
+
+    sfree(normals);
+    sfree(mean);
+    sfree(gauss);
+    sfree(interior);
+}
+
+
+static int uf_find(int *parent, int i) {
+    while(parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+
+static void average_box(const struct tri_area *ga, matrix *box, matrix avg_box, int *nframes) {
+    clear_mat(avg_box);
+    *nframes = 0;
+    for(int fr = 0; fr < ga->nframes; ++fr) {
+        if(ga->done && !ga->done[fr])   continue;
+        m_add(avg_box, box[fr], avg_box);
+        ++(*nframes);
+    }
+    if(*nframes > 0)    msmul(avg_box, 1.0 / *nframes, avg_box);
+}
+
+
+static void map_nodes(matrix box, int nx, int ny, rvec *q) {
+    for(int ia = 0; ia < nx; ++ia) {
+        for(int ib = 0; ib < ny; ++ib) {
+            real sa = (ia + 0.5) / nx, sb = (ib + 0.5) / ny;
+            rvec *p = &q[ia * ny + ib];
+            (*p)[XX] = sa * box[XX][XX] + sb * box[YY][XX];
+            (*p)[YY] = sa * box[XX][YY] + sb * box[YY][YY];
+            (*p)[ZZ] = 0;
+        }
+    }
+}
+
+
+static void splat_areas(const rvec *x, 
+                        const real *aa, 
+                        int natoms, 
+                        matrix box, 
+                        int nx, 
+                        int ny, 
+                        real *map_area, 
+                        int *map_count) {
+    real ax = box[XX][XX], ay = box[XX][YY];
+    real bx = box[YY][XX], by = box[YY][YY];
+    real det = ax * by - ay * bx;
+    real sa, sb;
+    int ia, ib;
+
+    for(int i = 0; i < natoms; ++i) {
+        // fractional coordinates wrapped into [0, 1)
+        sa = (by * x[i][XX] - bx * x[i][YY]) / det;
+        sb = (ax * x[i][YY] - ay * x[i][XX]) / det;
+        sa -= floor(sa);
+        sb -= floor(sb);
+
+        ia = (int)(sa * nx);
+        ib = (int)(sb * ny);
+        if(ia >= nx)    ia = nx - 1;
+        if(ib >= ny)    ib = ny - 1;
+
+        map_area[ia * ny + ib] += aa[i];
+        ++map_count[ia * ny + ib];
+    }
+}
+
+
+void split_leaflets(const rvec *x, 
+                    int natoms, 
+                    matrix box, 
+                    rvec *x_upper, 
+                    int *ind_upper, 
+                    int *n_upper, 
+                    rvec *x_lower, 
+                    int *ind_lower, 
+                    int *n_lower) {
+    real center = 0;
+    int nu = 0, nl = 0;
+
+    // The bilayer centre is the mean z-coordinate of the group
+    for(int i = 0; i < natoms; ++i) {
+        center += x[i][ZZ];
+    }
+    center /= natoms;
+
+    for(int i = 0; i < natoms; ++i) {
+        if(x[i][ZZ] >= center) {
+            if(ind_upper)   ind_upper[nu] = i;
+            copy_rvec(x[i], x_upper[nu++]);
+        }
+        else {
+            if(ind_lower)   ind_lower[nl] = i;
+            copy_rvec(x[i], x_lower[nl++]);
+        }
+    }
+
+    *n_upper = nu;
+    *n_lower = nl;
+}
+
+
+static int add_edge_points(const rvec *x, 
+                           int natoms, 
+                           matrix box, 
+                           real espace, 
+                           rvec **x_corr) {
+    if(natoms == 0) {
+        *x_corr = NULL;
+        return 0;
+    }
+
+    // The periodic cell in the xy-plane is the parallelogram spanned by the xy-components of box vectors a and b.
+    // Points are located within it by their fractional coordinates (sa, sb) along a and b.
+    real ax = box[XX][XX], ay = box[XX][YY];
+    real bx = box[YY][XX], by = box[YY][YY];
+    real det = ax * by - ay * bx;
+    real len_a = sqrt(ax * ax + ay * ay);
+    real len_b = sqrt(bx * bx + by * by);
+
+    // Calculate number of edge points
+    int n_edge_a = len_a / espace;
+    int n_edge_b = len_b / espace;
+
+    // Fractional coordinates and squared distances from the origin and from corner b
+    real *sa, *sb, *d0, *db;
+    snew(sa, natoms);
+    snew(sb, natoms);
+    snew(d0, natoms);
+    snew(db, natoms);
+
+    for(int j = 0; j < natoms; ++j) {
+        real px = x[j][XX], py = x[j][YY];
+        sa[j] = (by * px - bx * py) / det;
+        sb[j] = (ax * py - ay * px) / det;
+        d0[j] = px * px + py * py;
+        db[j] = (px - bx) * (px - bx) + (py - by) * (py - by);
+    }
+
+    // z-coordinates of particles closest to box corners
+    real bot_left = FLT_MAX, top_right = -FLT_MAX, 
+        top_left = FLT_MAX, bot_right = -FLT_MAX, 
+        avg_z;
+    int bot_left_ind = 0, top_right_ind = 0, top_left_ind = 0, bot_right_ind = 0;
+
+    for(int j = 0; j < natoms; ++j) {
+        // min and max distance from origin
+        if(d0[j] < bot_left) {
+            bot_left = d0[j];
+            bot_left_ind = j;
+        }
+        if(d0[j] > top_right) {
+            top_right = d0[j];
+            top_right_ind = j;
+        }
+
+        // min and max distance from top left corner
+        if(db[j] < top_left) {
+            top_left = db[j];
+            top_left_ind = j;
+        }
+        if(db[j] > bot_right) {
+            bot_right = db[j];
+            bot_right_ind = j;
+        }
+    }
+
+    sfree(d0);
+    sfree(db);
+
+    // Find min max fractional coordinates for each interval
+    real *b_mins, *b_maxes, *a_mins, *a_maxes;
+    snew(b_mins, n_edge_a + 1);
+    snew(b_maxes, n_edge_a + 1);
+    snew(a_mins, n_edge_b + 1);
+    snew(a_maxes, n_edge_b + 1);
+
+    int *b_min_inds, *b_max_inds, *a_min_inds, *a_max_inds;
+    snew(b_min_inds, n_edge_a + 1);
+    snew(b_max_inds, n_edge_a + 1);
+    snew(a_min_inds, n_edge_b + 1);
+    snew(a_max_inds, n_edge_b + 1);
+
+    for(int i = 0; i <= n_edge_a; ++i)
+        b_mins[i] = FLT_MAX;
+    for(int i = 0; i <= n_edge_a; ++i)
+        b_maxes[i] = -FLT_MAX;
+    for(int i = 0; i <= n_edge_b; ++i)
+        a_mins[i] = FLT_MAX;
+    for(int i = 0; i <= n_edge_b; ++i)
+        a_maxes[i] = -FLT_MAX;
+
+    int a_interval, b_interval;
+    for(int j = 0; j < natoms; ++j) {
+        // Check min max b in a interval. Particles outside of the box are counted in the nearest interval.
+        a_interval = (int)(sa[j] * n_edge_a);
+        if(a_interval < 0)          a_interval = 0;
+        if(a_interval > n_edge_a)   a_interval = n_edge_a;
+
+        if(sb[j] < b_mins[a_interval]) {
+            b_mins[a_interval] = sb[j];
+            b_min_inds[a_interval] = j;
+        }
+
+        if(sb[j] > b_maxes[a_interval]) {
+            b_maxes[a_interval] = sb[j];
+            b_max_inds[a_interval] = j;
+        }
+
+        // Check min max a in b interval
+        b_interval = (int)(sb[j] * n_edge_b);
+        if(b_interval < 0)          b_interval = 0;
+        if(b_interval > n_edge_b)   b_interval = n_edge_b;
+        
+        if(sa[j] < a_mins[b_interval]) {
+            a_mins[b_interval] = sa[j];
+            a_min_inds[b_interval] = j;
+        }
+
+        if(sa[j] > a_maxes[b_interval]) {
+            a_maxes[b_interval] = sa[j];
+            a_max_inds[b_interval] = j;
+        }
+    }
+
+    avg_z = ( x[bot_left_ind][ZZ] 
+            + x[top_right_ind][ZZ] 
+            + x[top_left_ind][ZZ] 
+            + x[bot_right_ind][ZZ]) / 4.0;
+
+    // copy the original points and add edge and corner points after them
+    rvec *xc;
+    snew(xc, natoms + 2 * (n_edge_a + 1) + 2 * (n_edge_b + 1));
+    memcpy(xc, x, natoms * sizeof(rvec));
+    int n = natoms;
+
+    // Add corner points
+    xc[n][XX]    = 0;
+    xc[n][YY]    = 0;
+    xc[n++][ZZ]  = avg_z;
+
+    xc[n][XX]    = ax;
+    xc[n][YY]    = ay;
+    xc[n++][ZZ]  = avg_z;
+
+    xc[n][XX]    = ax + bx;
+    xc[n][YY]    = ay + by;
+    xc[n++][ZZ]  = avg_z;
+
+    xc[n][XX]    = bx;
+    xc[n][YY]    = by;
+    xc[n++][ZZ]  = avg_z;
+
+    // Add edge points
+    real t, dist, dist1, dist2;
+    for(int j = 0; j < n_edge_a; ++j) {
+        // Bottom edge
+        t = (j * espace + espace / 2) / len_a; // Go to middle of interval
+        xc[n][XX] = t * ax;
+        xc[n][YY] = t * ay;
+        // edge Z coord is distance-from-edge-weighted average between the Zs of the two points closest to the two edges of this axis
+        dist1 = sb[b_min_inds[j]];
+        dist2 = 1 - sb[b_max_inds[j]];
+        dist = dist1 + dist2;
+        avg_z = x[b_min_inds[j]][ZZ] - (dist1/dist)*(x[b_min_inds[j]][ZZ]) 
+              + x[b_max_inds[j]][ZZ] - (dist2/dist)*(x[b_max_inds[j]][ZZ]);
+        xc[n++][ZZ] = avg_z;
+
+        // Top edge
+        xc[n][XX] = bx + t * ax;
+        xc[n][YY] = by + t * ay;
+        xc[n++][ZZ] = avg_z;
+    }
+
+    for(int j = 0; j < n_edge_b; ++j) {
+        // Left edge
+        t = (j * espace + espace / 2) / len_b;
+        xc[n][XX] = t * bx;
+        xc[n][YY] = t * by;
+        
+        dist1 = sa[a_min_inds[j]];
+        dist2 = 1 - sa[a_max_inds[j]];
+        dist = dist1 + dist2;
+        avg_z = x[a_min_inds[j]][ZZ] - (dist1/dist)*(x[a_min_inds[j]][ZZ])
+              + x[a_max_inds[j]][ZZ] - (dist2/dist)*(x[a_max_inds[j]][ZZ]);
+        xc[n++][ZZ] = avg_z;
+
+        // Right edge
+        xc[n][XX] = ax + t * bx;
+        xc[n][YY] = ay + t * by;
+        xc[n++][ZZ] = avg_z;
+    }
+
+    sfree(sa);
+    sfree(sb);
+    sfree(b_mins);
+    sfree(b_maxes);
+    sfree(a_mins);
+    sfree(a_maxes);
+    sfree(b_min_inds);
+    sfree(b_max_inds);
+    sfree(a_min_inds);
+    sfree(a_max_inds);
+
+    *x_corr = xc;
+    return n;
+}
+
+
+void delaunay_surface_area(const rvec *x,
+                           matrix box, 
+                           int natoms, 
+                           unsigned long flags,
+                           real *a2D,
+                           real *a3D) {
+    struct dTriangulation tri;
+
+    delaunay_triangulate(x, natoms, &tri);
+
+    tri_surface_area(x, &tri, natoms, a2D, a3D, NULL, NULL);
+
+    free(tri.triangles);
+}
+
+
+void delaunay_triangulate(const rvec *x, 
+                          int natoms, 
+                          struct dTriangulation *tri) {
+    tri->triangles = NULL;
+    tri->ntriangles = 0;
+
+    // Input initialization
+    snew(tri->points, 2 * natoms);
+    tri->npoints = natoms;
+
+    for(int i = 0; i < natoms; ++i) {
+        tri->points[2*i] = x[i][XX];
+        tri->points[2*i+1] = x[i][YY];
+    }
+
+    // triangulate
+    dtriangulate(tri);
+
+    sfree(tri->points);
+    tri->points = NULL;
+}
+
+
+void tri_surface_area(const rvec *x, 
+                      const struct dTriangulation *tri, 
+                      int natoms, 
+                      real *a2D, 
+                      real *a3D, 
+                      real *atom_area, 
+                      struct gta_hist *hist) {
+    real sum2D = 0, sum3D = 0, area;
+    rvec a, b, c;
+    int *t;
+
+    // calculate surface area of triangles
+    for(int i = 0; i < tri->ntriangles; ++i) {
+        t = &(tri->triangles[3*i]);
+
+        if(a3D || atom_area || hist) {
+            area = area_tri(x[t[0]], x[t[1]], x[t[2]]);
+            sum3D += area;
+
+            if(hist && t[0] < natoms && t[1] < natoms && t[2] < natoms) {
+                hist_add(hist, area);
+            }
+
+            if(atom_area) { // split the triangle's area between its atoms
+                int nreal = (t[0] < natoms) + (t[1] < natoms) + (t[2] < natoms);
+                if(nreal > 0) {
+                    area /= nreal;
+                    for(int j = 0; j < 3; ++j) {
+                        if(t[j] < natoms)   atom_area[t[j]] += area;
+                    }
+                }
+            }
+        }
+
+        if(a2D) {
+            copy_rvec(x[t[0]], a);
+            copy_rvec(x[t[1]], b);
+            copy_rvec(x[t[2]], c);
+
+            a[ZZ] = 0;
+            b[ZZ] = 0;
+            c[ZZ] = 0;
+
+            sum2D += area_tri(a, b, c);
+        }
+    }
+
+    if(a2D)     *a2D = sum2D;
+    if(a3D)     *a3D = sum3D;
+}
+
+
+void tri_surface_curvature(const rvec *x, 
+                           const struct dTriangulation *tri, 
+                           int natoms, 
+                           rvec *normals, 
+                           real *mean, 
+                           real *gauss, 
+                           int *interior) {
+    rvec *lap, e1, e2, cr, d;
+    real *area, *angles, dot, crn, cot;
+    long *nbsum; // sum of the indices of the next minus the previous neighbour of each vertex over its triangles
+    int v[3];
+
+    snew(lap, natoms);
+    snew(area, natoms);
+    snew(angles, natoms);
+    snew(nbsum, natoms);
+    for(int i = 0; i < natoms; ++i) {
+        clear_rvec(normals[i]);
+    }
+
+    for(int t = 0; t < tri->ntriangles; ++t) {
+        v[0] = tri->triangles[3*t];
+        v[1] = tri->triangles[3*t+1];
+        v[2] = tri->triangles[3*t+2];
+
+        // counterclockwise in the xy-plane so that normals point towards +z and the neighbour sums are consistent
+        rvec_sub(x[v[1]], x[v[0]], e1);
+        rvec_sub(x[v[2]], x[v[0]], e2);
+        cprod(e1, e2, cr);
+        if(cr[ZZ] < 0) {
+            int tmp = v[1];
+            v[1] = v[2];
+            v[2] = tmp;
+            svmul(-1, cr, cr);
+        }
+        real a3 = norm(cr) / 6.0; // a third of the triangle's area
+
+        for(int j = 0; j < 3; ++j) {
+            int i = v[j], next = v[(j+1) % 3], prev = v[(j+2) % 3];
+
+            // angle at vertex i, whose cotangent weighs the opposite edge from next to prev
+            rvec_sub(x[next], x[i], e1);
+            rvec_sub(x[prev], x[i], e2);
+            dot = iprod(e1, e2);
+            cprod(e1, e2, d);
+            crn = norm(d);
+            cot = crn > 0 ? dot / crn : 0;
+
+            if(next < natoms) {
+                rvec_sub(x[prev], x[next], d);
+                svmul(cot / 2, d, d);
+                rvec_inc(lap[next], d);
+            }
+            if(prev < natoms) {
+                rvec_sub(x[next], x[prev], d);
+                svmul(cot / 2, d, d);
+                rvec_inc(lap[prev], d);
+            }
+
+            if(i < natoms) {
+                angles[i] += atan2(crn, dot);
+                area[i] += a3;
+                rvec_inc(normals[i], cr); // weighted by the triangle's area
+                nbsum[i] += next - prev;
+            }
+        }
+    }
+
+    for(int i = 0; i < natoms; ++i) {
+        // Around an interior vertex every neighbour is the next of one triangle and the previous of another
+        int in = area[i] > 0 && nbsum[i] == 0;
+        if(norm2(normals[i]) > 0)   unitv(normals[i], normals[i]);
+
+        if(in) {
+            // The cotangent Laplacian of the position is -2H times the normal
+            mean[i] = -iprod(lap[i], normals[i]) / (2 * area[i]);
+            gauss[i] = (2 * M_PI - angles[i]) / area[i];
+        }
+        else {
+            mean[i] = 0;
+            gauss[i] = 0;
+        }
+        if(interior)    interior[i] = in;
+    }
+
+    sfree(lap);
+    sfree(area);
+    sfree(angles);
+    sfree(nbsum);
+}
+
+
+void tri_surface_heights(const rvec *x, 
+                         int npoints, 
+                         const struct dTriangulation *tri, 
+                         const rvec *q, 
+                         int nq, 
+                         real *z, 
+                         int *inside) {
+    struct dtLocator loc;
+    dtreal *points, *qxy, *bary;
+    int *qtri;
+
+    snew(points, 2 * npoints);
+    for(int i = 0; i < npoints; ++i) {
+        points[2*i] = x[i][XX];
+        points[2*i+1] = x[i][YY];
+    }
+    dtlocinit(&loc, points, tri);
+    sfree(points);
+
+    snew(qxy, 2 * nq);
+    snew(qtri, nq);
+    snew(bary, 3 * nq);
+    for(int i = 0; i < nq; ++i) {
+        qxy[2*i] = q[i][XX];
+        qxy[2*i+1] = q[i][YY];
+    }
+
+    dtlocateall(&loc, qxy, nq, qtri, bary);
+
+    // linear interpolation of the heights of the vertices of each query point's triangle
+    for(int i = 0; i < nq; ++i) {
+        if(qtri[i] >= 0) {
+            const int *t = &(loc.triangles[3 * qtri[i]]);
+            z[i] = bary[3*i] * x[t[0]][ZZ] + bary[3*i+1] * x[t[1]][ZZ] + bary[3*i+2] * x[t[2]][ZZ];
+        }
+        else {
+            z[i] = 0;
+        }
+        if(inside)  inside[i] = qtri[i] >= 0;
+    }
+
+    dtlocfree(&loc);
+    sfree(qxy);
+    sfree(qtri);
+    sfree(bary);
+}
+
+
+void print_areas(const char *fname, int ngroups, const struct tri_area *areas) {
+    FILE *f = fopen(fname, "w");
+    int nframes = areas[0].nframes;
+    int nsurf = (areas[0].leaflet == GTA_WHOLE) ? 1 : 2;
+
+    print_area_header(f, ngroups, areas);
+
+    for(int fr = 0; fr < nframes; ++fr) {
+        if(areas[0].done && !areas[0].done[fr])     continue;
+        print_area_row(f, ngroups, areas, fr);
+    }
+
+    for(int i = 0; i < nsurf * ngroups; ++i) {
+        const struct tri_area *ga = &areas[i];
+
+        print_surface_stats(ngroups, areas, i);
+
+        for(int t = 0; t < ga->ntypes; ++t) {
+            real sum_type = 0;
+            long count = 0;
+            for(int fr = 0; fr < nframes; ++fr) {
+                sum_type += ga->type_area[fr * ga->ntypes + t];
+                count += ga->type_natoms[fr * ga->ntypes + t];
+            }
+            print_log("Average area per particle of type %d: %f\n", t, count > 0 ? sum_type / count : 0);
+        }
+
+        if(ga->coord) {
+            real sum_coord = 0, sum_exch = 0;
+            int nfr = 0, nexch = 0;
+            for(int fr = 0; fr < nframes; ++fr) {
+                if(ga->done && !ga->done[fr])   continue;
+                sum_coord += ga->coord[fr];
+                ++nfr;
+                if(ga->exchange[fr] >= 0) {
+                    sum_exch += ga->exchange[fr];
+                    ++nexch;
+                }
+            }
+            print_log("Average coordination number: %f\n", nfr > 0 ? sum_coord / nfr : 0);
+            if(nexch > 0)
+                print_log("Average fraction of neighbours exchanged per frame: %f\n", sum_exch / nexch);
+        }
+
+        if(ga->psi6) {
+            real sum_psi6 = 0;
+            int nfr = 0;
+            for(int fr = 0; fr < nframes; ++fr) {
+                if(ga->done && !ga->done[fr])   continue;
+                sum_psi6 += ga->psi6[fr];
+                ++nfr;
+            }
+            print_log("Average hexatic order |psi6|: %f\n", nfr > 0 ? sum_psi6 / nfr : 0);
+        }
+
+        if(ga->mean_curv) {
+            real sum_mean = 0, sum_gauss = 0;
+            int nfr = 0;
+            for(int fr = 0; fr < nframes; ++fr) {
+                if(ga->done && !ga->done[fr])   continue;
+                sum_mean += ga->mean_curv[fr];
+                sum_gauss += ga->gauss_curv[fr];
+                ++nfr;
+            }
+            print_log("Average mean curvature: %f /nm, gaussian curvature: %f /nm^2\n", 
+                nfr > 0 ? sum_mean / nfr : 0, nfr > 0 ? sum_gauss / nfr : 0);
         }
     }
-    print_log("Average surface area: %f\n", sum / areas->nframes);
-    print_log("Average area per particle: %f\n", (sum / areas->nframes) / areas->natoms);
 
     fclose(f);
     print_log("Surface areas saved to %s\n", fname);
 }
 
-void print_dtrifiles(const struct dTriangulation *tri, 
-                     const char *node_name, 
-                     const char *ele_name) {
-    // print points to node file
-    FILE *node = fopen(node_name, "w");
+void print_area_map(const char *fname, int ngroups, const struct tri_area *areas) {
+    FILE *f = fopen(fname, "w");
+    int nsurf = (areas[0].leaflet == GTA_WHOLE) ? 1 : 2;
+    const char *lnames[] = {"", " upper leaflet", " lower leaflet"};
+
+    if(!f) {
+        log_fatal(FARGS, "Could not open %s for writing.\n", fname);
+    }
+
+    fprintf(f, "# Time-averaged area per particle maps\n");
+    fprintf(f, "# X\tY\tAREA/PARTICLE\tPARTICLES/FRAME\n");
+
+    for(int i = 0; i < nsurf * ngroups; ++i) {
+        const struct area_map *map = &areas[i].map;
+
+        // Blocks are separated by two blank lines, and rows of x bins by one, for gnuplot's index and pm3d
+        if(i > 0)   fprintf(f, "\n\n");
+        fprintf(f, "# Group %d%s, %d frames\n", i / nsurf, lnames[areas[i].leaflet], map->nframes);
+
+        for(int ia = 0; ia < map->nx; ++ia) {
+            for(int ib = 0; ib < map->ny; ++ib) {
+                int b = ia * map->ny + ib;
+                real sa = (ia + 0.5) / map->nx, sb = (ib + 0.5) / map->ny;
+
+                fprintf(f, "%f\t%f\t%f\t%f\n", 
+                    sa * map->box[XX][XX] + sb * map->box[YY][XX], 
+                    sa * map->box[XX][YY] + sb * map->box[YY][YY], 
+                    map->count[b] > 0 ? map->area[b] / map->count[b] : 0, 
+                    map->nframes > 0 ? (real)map->count[b] / map->nframes : 0);
+            }
+            fprintf(f, "\n");
+        }
+    }
+
+    fclose(f);
+    print_log("Area per particle maps saved to %s\n", fname);
+}
+
+void print_thickness_map(const char *fname, int ngroups, const struct tri_area *areas) {
+    FILE *f = fopen(fname, "w");
 
-    fprintf(node, "%d\t2\t0\t0\n", tri->npoints);
-    for(int i = 0; i < tri->npoints; ++i) {
-        fprintf(node, "%d\t%f\t%f\n", i, tri->points[2*i], tri->points[2*i + 1]);
+    if(!f) {
+        log_fatal(FARGS, "Could not open %s for writing.\n", fname);
     }
 
-    fclose(node);
+    fprintf(f, "# Time-averaged thickness maps\n");
+    fprintf(f, "# X\tY\tTHICKNESS\tFRACTION\n");
 
-    // print triangles to ele file
-    FILE *ele = fopen(ele_name, "w");
+    for(int g = 0; g < ngroups; ++g) {
+        const struct thickness_map *map = &areas[2 * g].thick;
+        rvec *q;
+        snew(q, map->nx * map->ny);
+        map_nodes((rvec*)map->box, map->nx, map->ny, q);
 
-    fprintf(ele, "%d\t3\t0\n", tri->ntriangles);
-    for(int i = 0; i < tri->ntriangles; ++i) {
-        fprintf(ele, "%d\t%d\t%d\t%d\n", 
-            i, tri->triangles[3*i], tri->triangles[3*i + 1], tri->triangles[3*i + 2]);
+        if(g > 0)   fprintf(f, "\n\n");
+        fprintf(f, "# Group %d, %d frames\n", g, map->nframes);
+
+        for(int ia = 0; ia < map->nx; ++ia) {
+            for(int ib = 0; ib < map->ny; ++ib) {
+                int b = ia * map->ny + ib;
+                fprintf(f, "%f\t%f\t%f\t%f\n", q[b][XX], q[b][YY], map->thickness[b], 
+                    map->nframes > 0 ? (real)map->count[b] / map->nframes : 0);
+            }
+            fprintf(f, "\n");
+        }
+
+        sfree(q);
+    }
+
+    fclose(f);
+    print_log("Thickness maps saved to %s\n", fname);
+}
+
+void print_domain_sizes(const char *fname, int ngroups, const struct tri_area *areas) {
+    FILE *f = fopen(fname, "w");
+    int nsurf = (areas[0].leaflet == GTA_WHOLE) ? 1 : 2;
+    int ntypes = areas[0].ntypes, max_natoms = 0;
+    const char *lnames[] = {"", "U", "L"};
+
+    if(!f) {
+        log_fatal(FARGS, "Could not open %s for writing.\n", fname);
+    }
+
+    fprintf(f, "# Average number of domains of each size per frame\n");
+    fprintf(f, "# SIZE");
+    for(int i = 0; i < nsurf * ngroups; ++i) {
+        char gs[32] = "";
+        if(nsurf * ngroups > 1)     sprintf(gs, "(%d%s)", i / nsurf, lnames[areas[i].leaflet]);
+        for(int t = 0; t < ntypes; ++t)
+            fprintf(f, "\tTYPE%d%s", t, gs);
+        if(areas[i].natoms > max_natoms)    max_natoms = areas[i].natoms;
+    }
+    fprintf(f, "\n");
+
+    for(int size = 1; size <= max_natoms; ++size) {
+        fprintf(f, "%d", size);
+        for(int i = 0; i < nsurf * ngroups; ++i) {
+            const struct tri_area *ga = &areas[i];
+            int n = ga->natoms + 1, nfr = 0;
+            for(int fr = 0; fr < ga->nframes; ++fr) {
+                if(!ga->done || ga->done[fr])   ++nfr;
+            }
+            for(int t = 0; t < ntypes; ++t) {
+                fprintf(f, "\t%f", (size < n && nfr > 0) ? (real)ga->domain_sizes[t * n + size] / nfr : 0);
+            }
+        }
+        fprintf(f, "\n");
+    }
+
+    fclose(f);
+    print_log("Domain size distributions saved to %s\n", fname);
+}
+
+void print_histograms(const char *fname, int ngroups, const struct tri_area *areas) {
+    FILE *f = fopen(fname, "w");
+    int nsurf = (areas[0].leaflet == GTA_WHOLE) ? 1 : 2;
+    const char *lnames[] = {"", "U", "L"};
+
+    if(!f) {
+        log_fatal(FARGS, "Could not open %s for writing.\n", fname);
+    }
+
+    for(int h = 0; h < 2; ++h) {
+        // Triangle areas, then edge lengths, as probability densities
+        const char *name = h ? "EDGE-LENGTH" : "TRIANGLE-AREA";
+        const struct gta_hist *h0 = h ? &areas[0].edge_hist : &areas[0].tri_hist;
+        double width = h0->max / h0->nbins;
+
+        if(h > 0)   fprintf(f, "\n\n");
+        for(int i = 0; i < nsurf * ngroups; ++i) {
+            const struct gta_hist *hi = h ? &areas[i].edge_hist : &areas[i].tri_hist;
+            fprintf(f, "# Surface %d: %ld values, %ld >= %f\n", i, hi->n, hi->nover, hi->max);
+        }
+        fprintf(f, "# %s", name);
+        for(int i = 0; i < nsurf * ngroups; ++i) {
+            char gs[32] = "";
+            if(nsurf * ngroups > 1)     sprintf(gs, "(%d%s)", i / nsurf, lnames[areas[i].leaflet]);
+            fprintf(f, "\tP%s", gs);
+        }
+        fprintf(f, "\n");
+
+        for(int b = 0; b < h0->nbins; ++b) {
+            fprintf(f, "%f", (b + 0.5) * width);
+            for(int i = 0; i < nsurf * ngroups; ++i) {
+                const struct gta_hist *hi = h ? &areas[i].edge_hist : &areas[i].tri_hist;
+                fprintf(f, "\t%f", hi->n > 0 ? hi->count[b] / (hi->n * width) : 0);
+            }
+            fprintf(f, "\n");
+        }
     }
 
-    fclose(ele);
+    fclose(f);
+    print_log("Triangle area and edge length distributions saved to %s\n", fname);
+}
+
+static void print_stats(const char *name, const struct gta_stats *s) {
+    print_log("%-18s%14f%14f%14f%14f\n", name, s->mean, stats_var(s), stats_sem(s), stats_tau(s));
 }
 
 void free_tri_area(struct tri_area *areas) {
     if(areas->area)         sfree(areas->area);
     if(areas->area2D)       sfree(areas->area2D);
     if(areas->area2Dbox)    sfree(areas->area2Dbox);
+    if(areas->time)         sfree(areas->time);
+    if(areas->natoms_fr)    sfree(areas->natoms_fr);
+    if(areas->type_area)    sfree(areas->type_area);
+    if(areas->type_natoms)  sfree(areas->type_natoms);
+    if(areas->coord)        sfree(areas->coord);
+    if(areas->exchange)     sfree(areas->exchange);
+    if(areas->psi6)         sfree(areas->psi6);
+    if(areas->mean_curv)    sfree(areas->mean_curv);
+    if(areas->gauss_curv)   sfree(areas->gauss_curv);
+    if(areas->ndomains)     sfree(areas->ndomains);
+    if(areas->largest)      sfree(areas->largest);
+    if(areas->largest_area) sfree(areas->largest_area);
+    if(areas->domain_sizes) sfree(areas->domain_sizes);
+    if(areas->done)         sfree(areas->done);
+    if(areas->map.area)     sfree(areas->map.area);
+    if(areas->map.count)    sfree(areas->map.count);
+    if(areas->thick.thickness)  sfree(areas->thick.thickness);
+    if(areas->thick.count)      sfree(areas->thick.count);
+    if(areas->tri_hist.count)   hist_free(&areas->tri_hist);
+    if(areas->edge_hist.count)  hist_free(&areas->edge_hist);
+}
+
+
+static void clear_tri_area(struct tri_area *ga) {
+    ga->area = NULL;
+    ga->area2D = NULL;
+    ga->area2Dbox = NULL;
+    ga->time = NULL;
+    ga->natoms_fr = NULL;
+    ga->type_area = NULL;
+    ga->type_natoms = NULL;
+    ga->coord = NULL;
+    ga->exchange = NULL;
+    ga->psi6 = NULL;
+    ga->mean_curv = NULL;
+    ga->gauss_curv = NULL;
+    ga->ndomains = NULL;
+    ga->largest = NULL;
+    ga->largest_area = NULL;
+    ga->domain_sizes = NULL;
+    ga->done = NULL;
+    ga->map.area = NULL;
+    ga->map.count = NULL;
+    ga->thick.thickness = NULL;
+    ga->thick.count = NULL;
+    ga->tri_hist.count = NULL;
+    ga->edge_hist.count = NULL;
+    ga->area_modulus = 0;
+}
+
+
+static void lipid_types(atom_id **indx, const int *isize, int ngroups, int ntypes, int natoms, int ***types) {
+    int *atom_types; // Look up the lipid type of each atom of the triangulated groups
+    snew(atom_types, natoms);
+    for(int i = 0; i < natoms; ++i) {
+        atom_types[i] = -1;
+    }
+    for(int t = ntypes - 1; t >= 0; --t) { // first type group wins
+        for(int i = 0; i < isize[ngroups + t]; ++i) {
+            atom_types[indx[ngroups + t][i]] = t;
+        }
+    }
+
+    snew(*types, ngroups);
+    for(int g = 0; g < ngroups; ++g) {
+        snew((*types)[g], isize[g]);
+        for(int i = 0; i < isize[g]; ++i) {
+            (*types)[g][i] = atom_types[indx[g][i]];
+        }
+    }
+    sfree(atom_types);
+}
+
+
+static void print_area_header(FILE *f, int ngroups, const struct tri_area *areas) {
+    int nsurf = (areas[0].leaflet == GTA_WHOLE) ? 1 : 2;
+    const char *lnames[] = {"", "U", "L"};
+
+    // Column headers, suffixed by group number and leaflet if there is more than one surface
+    fprintf(f, "# TIME");
+    for(int i = 0; i < nsurf * ngroups; ++i) {
+        char gs[32] = "";
+        if(nsurf * ngroups > 1)     sprintf(gs, "(%d%s)", i / nsurf, lnames[areas[i].leaflet]);
+
+        if(areas[i].natoms_fr)
+            fprintf(f, "\tNATOMS%s", gs);
+        if(areas[i].area2D)
+            fprintf(f, "\tAREA%s\t2DAREA%s\tBOX-AREA%s\t\"\"/PARTICLE%s", gs, gs, gs, gs);
+        else
+            fprintf(f, "\tAREA%s\tBOX-AREA%s\t\"\"/PARTICLE%s", gs, gs, gs);
+        for(int t = 0; t < areas[i].ntypes; ++t)
+            fprintf(f, "\tAREA/TYPE%d%s", t, gs);
+        if(areas[i].coord)
+            fprintf(f, "\tCOORD%s\tEXCHANGE%s", gs, gs);
+        if(areas[i].psi6)
+            fprintf(f, "\tPSI6%s", gs);
+        if(areas[i].mean_curv)
+            fprintf(f, "\tMEAN-CURV%s\tGAUSS-CURV%s", gs, gs);
+        for(int t = 0; areas[i].ndomains && t < areas[i].ntypes; ++t)
+            fprintf(f, "\tDOMAINS/TYPE%d%s\tLARGEST/TYPE%d%s\tLARGEST-AREA/TYPE%d%s", t, gs, t, gs, t, gs);
+    }
+    fprintf(f, "\n");
+}
+
+
+static void print_area_row(FILE *f, int ngroups, const struct tri_area *areas, int fr) {
+    int nsurf = (areas[0].leaflet == GTA_WHOLE) ? 1 : 2;
+
+    fprintf(f, "%f", areas[0].time[fr]);
+    for(int i = 0; i < nsurf * ngroups; ++i) {
+        const struct tri_area *ga = &areas[i];
+        int natoms = ga->natoms;
+
+        if(ga->natoms_fr) {
+            natoms = ga->natoms_fr[fr];
+            fprintf(f, "\t%d", natoms);
+        }
+        int n = natoms > 0 ? natoms : 1; // the areas of surfaces without atoms are 0, and so are their areas per atom
+
+        if(ga->area2D) {
+            fprintf(f, "\t%f\t%f\t%f\t%f\t%f\t%f", ga->area[fr], ga->area2D[fr], ga->area2Dbox[fr], 
+                ga->area[fr] / n, ga->area2D[fr] / n, natoms > 0 ? ga->area2Dbox[fr] / n : 0);
+        }
+        else {
+            fprintf(f, "\t%f\t%f\t%f\t%f", ga->area[fr], ga->area2Dbox[fr], 
+                ga->area[fr] / n, natoms > 0 ? ga->area2Dbox[fr] / n : 0);
+        }
+
+        // Average area per atom of each lipid type
+        for(int t = 0; t < ga->ntypes; ++t) {
+            int k = fr * ga->ntypes + t;
+            fprintf(f, "\t%f", ga->type_natoms[k] > 0 ? ga->type_area[k] / ga->type_natoms[k] : 0);
+        }
+
+        // Coordination number and fraction of neighbours of the previous frame lost
+        if(ga->coord) {
+            fprintf(f, "\t%f\t%f", ga->coord[fr], ga->exchange[fr]);
+        }
+        if(ga->psi6) {
+            fprintf(f, "\t%f", ga->psi6[fr]);
+        }
+        if(ga->mean_curv) {
+            fprintf(f, "\t%f\t%f", ga->mean_curv[fr], ga->gauss_curv[fr]);
+        }
+
+        // Number of domains of each lipid type, and the number of atoms in and area of the largest
+        for(int t = 0; ga->ndomains && t < ga->ntypes; ++t) {
+            int k = fr * ga->ntypes + t;
+            fprintf(f, "\t%d\t%d\t%f", ga->ndomains[k], ga->largest[k], ga->largest_area[k]);
+        }
+    }
+    fprintf(f, "\n");
+}
+
+
+static void print_surface_stats(int ngroups, const struct tri_area *areas, int i) {
+    int nsurf = (areas[0].leaflet == GTA_WHOLE) ? 1 : 2;
+    const struct tri_area *ga = &areas[i];
+
+    if(ga->leaflet == GTA_UPPER)
+        print_log("Group %d upper leaflet:\n", i / nsurf);
+    else if(ga->leaflet == GTA_LOWER)
+        print_log("Group %d lower leaflet:\n", i / nsurf);
+    else if(ngroups > 1)
+        print_log("Group %d (%d particles):\n", i, ga->natoms);
+    print_log("Average surface area: %f\n", ga->stats[GTA_STAT_AREA].mean);
+    print_log("Average area per particle: %f\n", ga->stats[GTA_STAT_APL].mean);
+
+    print_log("%-18s%14s%14s%14s%14s\n", "", "MEAN", "VARIANCE", "STD-ERR", "TAU(FRAMES)");
+    print_stats("Area", &ga->stats[GTA_STAT_AREA]);
+    if(ga->area2D)  print_stats("2D area", &ga->stats[GTA_STAT_AREA2D]);
+    print_stats("Area/particle", &ga->stats[GTA_STAT_APL]);
+    print_stats("Box area", &ga->stats[GTA_STAT_BOX]);
+    if(ga->area_modulus > 0) {
+        print_log("Area compressibility modulus: %f kJ/mol/nm^2 (%f mN/m)\n", 
+            ga->area_modulus, ga->area_modulus * GTA_KJMOLNM2_MNM);
+    }
+}
+
+static int read_checkpoint(const struct gta_frames *frames, 
+                           unsigned long flags, 
+                           struct tri_run *run, 
+                           struct tri_area *areas) {
+    const char *fname = run->out->cpt_fname;
+    int nframes = areas[0].nframes, nareas = run->nsurf * run->ngroups, ntypes = areas[0].ntypes;
+    char magic[8];
+    int32_t hdr[4], *natoms;
+    uint32_t cpt_flags;
+    real espace, *times;
+    unsigned char *bits;
+
+    FILE *f = fopen(fname, "rb");
+    if(f == NULL)   return 0;
+
+    snew(natoms, nareas);
+    snew(times, nframes);
+    snew(bits, (nframes + 7) / 8);
+    int ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, "GTACPT2", 8) == 0 
+        && fread(hdr, sizeof(int32_t), 4, f) == 4 && fread(&cpt_flags, sizeof(uint32_t), 1, f) == 1 
+        && fread(&espace, sizeof(real), 1, f) == 1 
+        && hdr[0] == sizeof(real) && hdr[1] == nframes && hdr[2] == nareas && hdr[3] == ntypes 
+        && cpt_flags == (flags & CPT_FLAGS) && (!(flags & GTA_CORRECT) || espace == run->espace) 
+        && fread(natoms, sizeof(int32_t), nareas, f) == (size_t)nareas 
+        && fread(times, sizeof(real), nframes, f) == (size_t)nframes 
+        && fread(bits, 1, (nframes + 7) / 8, f) == (size_t)(nframes + 7) / 8;
+    for(int i = 0; i < nareas && ok; ++i) {
+        ok = natoms[i] == areas[i].natoms;
+    }
+    for(int fr = 0; fr < nframes && ok; ++fr) {
+        ok = times[fr] == frames->time[fr];
+    }
+    if(!ok) {
+        print_log("%s is not a checkpoint of these frames, groups and options, and will be overwritten.\n", fname);
+    }
+
+    int ndone = 0;
+    for(int fr = 0; fr < nframes && ok; ++fr) {
+        run->cpt_done[fr] = (bits[fr / 8] >> (fr % 8)) & 1;
+        for(int i = 0; i < nareas && ok && run->cpt_done[fr]; ++i) {
+            ok = read_checkpoint_frame(f, &areas[i], fr, flags);
+        }
+        ndone += run->cpt_done[fr];
+    }
+    fclose(f);
+
+    if(!ok) { // start over
+        memset(run->cpt_done, 0, nframes);
+        ndone = 0;
+        // The per-type values are summed while tessellating, so those already read must not be kept
+        for(int i = 0; i < nareas && ntypes > 0; ++i) {
+            memset(areas[i].type_area, 0, (size_t)nframes * ntypes * sizeof(*areas[i].type_area));
+            memset(areas[i].type_natoms, 0, (size_t)nframes * ntypes * sizeof(*areas[i].type_natoms));
+        }
+    }
+    sfree(natoms);
+    sfree(times);
+    sfree(bits);
+    return ndone;
+}
+
+static int write_checkpoint(const struct gta_frames *frames, 
+                            unsigned long flags, 
+                            const struct tri_run *run, 
+                            const struct tri_area *areas, 
+                            const unsigned char *done) {
+    const char *fname = run->out->cpt_fname;
+    int nframes = areas[0].nframes, nareas = run->nsurf * run->ngroups;
+    int32_t hdr[4] = {sizeof(real), nframes, nareas, areas[0].ntypes};
+    uint32_t cpt_flags = flags & CPT_FLAGS;
+    int32_t *natoms;
+    unsigned char *bits;
+
+    snew(natoms, nareas);
+    for(int i = 0; i < nareas; ++i) {
+        natoms[i] = areas[i].natoms;
+    }
+    snew(bits, (nframes + 7) / 8);
+    for(int fr = 0; fr < nframes; ++fr) {
+        if(done[fr])    bits[fr / 8] |= 1 << (fr % 8);
+    }
+
+    size_t len = strlen(fname);
+    char *tmp_fname;
+    snew(tmp_fname, len + 5);
+    memcpy(tmp_fname, fname, len);
+    memcpy(tmp_fname + len, ".tmp", 5);
+
+    FILE *f = fopen(tmp_fname, "wb");
+    int ok = f != NULL 
+        && fwrite("GTACPT2", 1, 8, f) == 8 
+        && fwrite(hdr, sizeof(int32_t), 4, f) == 4 
+        && fwrite(&cpt_flags, sizeof(uint32_t), 1, f) == 1 
+        && fwrite(&run->espace, sizeof(real), 1, f) == 1 
+        && fwrite(natoms, sizeof(int32_t), nareas, f) == (size_t)nareas 
+        && fwrite(frames->time, sizeof(real), nframes, f) == (size_t)nframes 
+        && fwrite(bits, 1, (nframes + 7) / 8, f) == (size_t)(nframes + 7) / 8;
+    for(int fr = 0; fr < nframes && ok; ++fr) {
+        for(int i = 0; i < nareas && ok && done[fr]; ++i) {
+            ok = write_checkpoint_frame(f, &areas[i], fr, flags);
+        }
+    }
+    if(f)   ok = fclose(f) == 0 && ok;
+
+    if(!ok || rename(tmp_fname, fname) != 0) {
+        remove(tmp_fname);
+        print_log("Could not save the checkpoint to %s\n", fname);
+        ok = 0;
+    }
+    sfree(tmp_fname);
+    sfree(natoms);
+    sfree(bits);
+    return ok;
+}
+
+static int read_checkpoint_frame(FILE *f, struct tri_area *ga, int fr, unsigned long flags) {
+#define CPT_READ(p, n) (fread((p), sizeof(*(p)), (n), f) == (size_t)(n))
+    int ntypes = ga->ntypes;
+    int ok = CPT_READ(&ga->area[fr], 1) && CPT_READ(&ga->area2Dbox[fr], 1);
+    if(flags & GTA_2D)          ok = ok && CPT_READ(&ga->area2D[fr], 1);
+    if(flags & GTA_LEAFLETS)    ok = ok && CPT_READ(&ga->natoms_fr[fr], 1);
+    if(ntypes > 0) {
+        ok = ok && CPT_READ(&ga->type_area[fr * ntypes], ntypes) && CPT_READ(&ga->type_natoms[fr * ntypes], ntypes);
+    }
+    if(flags & GTA_PSI6)        ok = ok && CPT_READ(&ga->psi6[fr], 1);
+    if(flags & GTA_CURVATURE) {
+        ok = ok && CPT_READ(&ga->mean_curv[fr], 1) && CPT_READ(&ga->gauss_curv[fr], 1);
+    }
+#undef CPT_READ
+    return ok;
+}
+
+static int write_checkpoint_frame(FILE *f, const struct tri_area *ga, int fr, unsigned long flags) {
+#define CPT_WRITE(p, n) (fwrite((p), sizeof(*(p)), (n), f) == (size_t)(n))
+    int ntypes = ga->ntypes;
+    int ok = CPT_WRITE(&ga->area[fr], 1) && CPT_WRITE(&ga->area2Dbox[fr], 1);
+    if(flags & GTA_2D)          ok = ok && CPT_WRITE(&ga->area2D[fr], 1);
+    if(flags & GTA_LEAFLETS)    ok = ok && CPT_WRITE(&ga->natoms_fr[fr], 1);
+    if(ntypes > 0) {
+        ok = ok && CPT_WRITE(&ga->type_area[fr * ntypes], ntypes) && CPT_WRITE(&ga->type_natoms[fr * ntypes], ntypes);
+    }
+    if(flags & GTA_PSI6)        ok = ok && CPT_WRITE(&ga->psi6[fr], 1);
+    if(flags & GTA_CURVATURE) {
+        ok = ok && CPT_WRITE(&ga->mean_curv[fr], 1) && CPT_WRITE(&ga->gauss_curv[fr], 1);
+    }
+#undef CPT_WRITE
+    return ok;
 }
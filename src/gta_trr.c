@@ -0,0 +1,118 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#define _FILE_OFFSET_BITS 64 // for files over 2 GB
+#define _XOPEN_SOURCE 700 // for fseeko
+
+#include "gta_trr.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define TRR_MAGIC 1993
+#define TRR_VERSION "GMX_trn_file"
+#define TRR_CHUNK 1024 // Number of double precision reals converted at a time
+
+static int read_int(FILE *f, int *i);
+/* Reads a big endian XDR integer. Returns 0 on success, -1 on error or at the end of the file.
+ */
+
+static int read_reals(FILE *f, int is_double, int n, float *x);
+/* Reads n XDR reals of the given precision into x, or skips them if x is NULL. Returns 0 on success and -1 on error.
+ */
+
+static int real_size(const struct trr_header *hdr);
+/* Finds the size of the reals of a frame from the sizes of its blocks, as GROMACS does. Returns 0 if it cannot be found.
+ */
+
+
+int trr_read_header(FILE *f, struct trr_header *hdr) {
+    int magic, slen, len, sizes[11], nre;
+    char version[sizeof(TRR_VERSION)];
+
+    if(read_int(f, &magic))     return 0; // end of the file
+    if(magic != TRR_MAGIC)  return -1;
+    if(read_int(f, &slen) || read_int(f, &len) || len != (int)sizeof(TRR_VERSION) - 1 || slen != len + 1)   return -1;
+    if(fread(version, 1, len, f) != (size_t)len || memcmp(version, TRR_VERSION, len) != 0)  return -1; // a multiple of 4 bytes
+    for(int i = 0; i < 11; ++i) {
+        if(read_int(f, &sizes[i]) || sizes[i] < 0)  return -1;
+    }
+    // ir, e, box, vir, pres, top, sym, x, v and f sizes, and the number of atoms
+    hdr->box_size = sizes[2];
+    hdr->vir_size = sizes[3];
+    hdr->pres_size = sizes[4];
+    hdr->x_size = sizes[7];
+    hdr->v_size = sizes[8];
+    hdr->f_size = sizes[9];
+    hdr->natoms = sizes[10];
+    if(read_int(f, &hdr->step) || read_int(f, &nre))    return -1;
+
+    int size = real_size(hdr);
+    if(size == 0)   return -1;
+    hdr->is_double = size == sizeof(double);
+    if(read_reals(f, hdr->is_double, 1, &hdr->time) || read_reals(f, hdr->is_double, 1, &hdr->lambda))   return -1;
+    return 1;
+}
+
+int trr_read_data(FILE *f, const struct trr_header *hdr, float box[3][3], float *x) {
+    int size = hdr->is_double ? sizeof(double) : sizeof(float);
+    int blocks[6] = {hdr->box_size, hdr->vir_size, hdr->pres_size, hdr->x_size, hdr->v_size, hdr->f_size};
+    float *dest[6] = {box ? &box[0][0] : NULL, NULL, NULL, x, NULL, NULL};
+
+    for(int b = 0; b < 6; ++b) {
+        if(blocks[b] % size != 0)   return -1;
+        if(read_reals(f, hdr->is_double, blocks[b] / size, dest[b]))    return -1;
+    }
+    return 0;
+}
+
+
+static int read_int(FILE *f, int *i) {
+    unsigned char c[4];
+    if(fread(c, 1, 4, f) != 4)  return -1;
+    *i = (int)(((uint32_t)c[0] << 24) | ((uint32_t)c[1] << 16) | ((uint32_t)c[2] << 8) | c[3]);
+    return 0;
+}
+
+static int read_reals(FILE *f, int is_double, int n, float *x) {
+    if(n == 0)  return 0;
+    if(x == NULL)   return fseeko(f, (off_t)n * (is_double ? 8 : 4), SEEK_CUR) == 0 ? 0 : -1;
+
+    if(!is_double) { // read in place and swap to the byte order of the machine
+        unsigned char *c = (unsigned char*)x;
+        if(fread(c, 4, n, f) != (size_t)n)  return -1;
+        for(int i = 0; i < n; ++i, c += 4) {
+            uint32_t u = ((uint32_t)c[0] << 24) | ((uint32_t)c[1] << 16) | ((uint32_t)c[2] << 8) | c[3];
+            memcpy(&x[i], &u, sizeof(u));
+        }
+        return 0;
+    }
+
+    unsigned char c[8 * TRR_CHUNK];
+    for(int first = 0; first < n; first += TRR_CHUNK) {
+        int m = (n - first < TRR_CHUNK) ? n - first : TRR_CHUNK;
+        if(fread(c, 8, m, f) != (size_t)m)  return -1;
+        for(int i = 0; i < m; ++i) {
+            uint64_t u = 0;
+            double d;
+            for(int k = 0; k < 8; ++k) {
+                u = (u << 8) | c[8 * i + k];
+            }
+            memcpy(&d, &u, sizeof(d));
+            x[first + i] = (float)d;
+        }
+    }
+    return 0;
+}
+
+static int real_size(const struct trr_header *hdr) {
+    int size = 0;
+    if(hdr->box_size)   size = hdr->box_size / 9;
+    else if(hdr->x_size && hdr->natoms)     size = hdr->x_size / (3 * hdr->natoms);
+    else if(hdr->v_size && hdr->natoms)     size = hdr->v_size / (3 * hdr->natoms);
+    else if(hdr->f_size && hdr->natoms)     size = hdr->f_size / (3 * hdr->natoms);
+    else if(hdr->vir_size)  size = hdr->vir_size / 9;
+    else if(hdr->pres_size)     size = hdr->pres_size / 9;
+    return (size == sizeof(float) || size == sizeof(double)) ? size : 0;
+}
@@ -0,0 +1,617 @@
+/*
+ * Copyright 2016 Ahnaf Siddiqui and Sameer Varma
+ */
+
+#define _FILE_OFFSET_BITS 64 // for files over 2 GB
+#define _XOPEN_SOURCE 700 // for fseeko, ftello and st_mtim
+
+#include "gta_xtc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define XTC_MAGIC 1995
+#define XTC_MAGIC_LARGE 2023 // Frames whose compressed coordinates are over 2 GB, with a 64-bit byte count
+#define XTC_MAXSMALL 9 // Frames with at most this many atoms are stored uncompressed
+#define XTC_FIRSTIDX 9 // Index of the first magic integer used for small differences
+#define XTC_INDEX_EXT ".gtaidx" // Extension of the index files saved next to trajectories
+
+// Sizes of the ranges of the small differences between consecutive atoms
+static const int magicints[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
+    80, 101, 128, 161, 203, 256, 322, 406, 512, 645, 812, 1024, 1290,
+    1625, 2048, 2580, 3250, 4096, 5060, 6501, 8192, 10321, 13003,
+    16384, 20642, 26007, 32768, 41285, 52015, 65536, 82570, 104031,
+    131072, 165140, 208063, 262144, 330280, 416127, 524287, 660561,
+    832255, 1048576, 1321122, 1664510, 2097152, 2642245, 3329021,
+    4194304, 5284491, 6658042, 8388607, 10568983, 13316085, 16777216
+};
+#define XTC_LASTIDX ((int)(sizeof(magicints) / sizeof(*magicints)))
+
+/* Position in a stream of compressed bits.
+ */
+struct bit_reader {
+    const unsigned char *bytes;
+    size_t nbytes, cnt; // Number of bytes and of bytes read
+    unsigned int lastbits, lastbyte; // Number of unread bits in lastbyte, and the last bytes read
+};
+
+static int read_int(FILE *f, int *i);
+static int read_int64(FILE *f, int64_t *i);
+static int read_float(FILE *f, float *x);
+/* Read big endian XDR values. Return 0 on success, -1 on error or at the end of the file.
+ */
+
+static int file_stamp(const char *fname, int64_t stamp[3]);
+/* Stores the size, modification time (s) and nanoseconds of the modification time of fname in stamp.
+ */
+
+static int load_index(const char *index_fname, const int64_t stamp[3], struct xtc_index *index);
+static int save_index(const char *index_fname, const struct xtc_index *index);
+/* Load and save index files (see xtc_cached_index). load_index fails if the index was saved for another stamp.
+ */
+
+static int index_complete(const char *fname, const struct xtc_index *index);
+/* Returns whether the last frame of index ends exactly at the end of fname, so that no incomplete frame was left out.
+ */
+
+static int read_header(FILE *f, int *natoms, int *step, float *time, float box[3][3], int *large);
+/* Reads the header of a frame. Returns 1 if it was read, 0 at the end of the file and -1 on error.
+ */
+
+static int decode_bits(struct bit_reader *b, int nbits);
+/* Reads an unsigned integer of nbits bits.
+ */
+
+static void decode_ints(struct bit_reader *b, int nbits, const unsigned int sizes[3], int nums[3]);
+/* Reads three integers packed together into nbits bits as a number in base sizes.
+ */
+
+static int sizeofint(int size);
+/* Number of bits needed for the integers from 0 to size - 1.
+ */
+
+static int sizeofints(const unsigned int sizes[3]);
+/* Number of bits needed for three integers packed together, each from 0 to sizes[i] - 1.
+ */
+
+
+int xtc_build_index(const char *fname, struct xtc_index *index) {
+    FILE *f = fopen(fname, "rb");
+    int capacity = 1024, natoms, ret;
+    float box[3][3];
+
+    int64_t stamp[3];
+
+    memset(index, 0, sizeof(*index));
+    if(f == NULL || file_stamp(fname, stamp) != 0) {
+        if(f)   fclose(f);
+        return -1;
+    }
+    index->file_size = stamp[0];
+    index->mtime_sec = stamp[1];
+    index->mtime_nsec = stamp[2];
+
+    index->offsets = malloc(capacity * sizeof(*index->offsets));
+    index->steps = malloc(capacity * sizeof(*index->steps));
+    index->times = malloc(capacity * sizeof(*index->times));
+    index->boxes = malloc(capacity * sizeof(*index->boxes));
+
+    for(;;) {
+        int64_t offset = ftello(f);
+        int fr = index->nframes;
+
+        if(fr >= capacity) {
+            capacity *= 2;
+            index->offsets = realloc(index->offsets, capacity * sizeof(*index->offsets));
+            index->steps = realloc(index->steps, capacity * sizeof(*index->steps));
+            index->times = realloc(index->times, capacity * sizeof(*index->times));
+            index->boxes = realloc(index->boxes, capacity * sizeof(*index->boxes));
+        }
+
+        ret = xtc_skip_frame(f, &natoms, &index->steps[fr], &index->times[fr], box);
+        // A last frame cut short, eg by a simulation that crashed while writing it, ends the trajectory. 
+        // Skipping its coordinates seeks past the end of the file without an error.
+        if(ret < 0 && feof(f))  ret = 0;
+        if(ret > 0 && ftello(f) > index->file_size)     ret = 0;
+        if(ret <= 0)    break;
+        if(fr > 0 && natoms != index->natoms) {
+            ret = -1;
+            break;
+        }
+
+        index->natoms = natoms;
+        index->offsets[fr] = offset;
+        memcpy(index->boxes[fr], box, sizeof(box));
+        ++index->nframes;
+    }
+
+    fclose(f);
+    if(ret < 0 || index->nframes == 0) {
+        xtc_free_index(index);
+        return -1;
+    }
+    return 0;
+}
+
+
+int xtc_cached_index(const char *fname, struct xtc_index *index, int *cached) {
+    size_t len = strlen(fname);
+    char *index_fname = malloc(len + sizeof(XTC_INDEX_EXT));
+    int64_t stamp[3];
+
+    *cached = 0;
+    if(index_fname == NULL)     return -1;
+    memcpy(index_fname, fname, len);
+    memcpy(index_fname + len, XTC_INDEX_EXT, sizeof(XTC_INDEX_EXT));
+
+    if(file_stamp(fname, stamp) == 0 && load_index(index_fname, stamp, index) == 0) {
+        *cached = 1;
+        free(index_fname);
+        return 0;
+    }
+
+    if(xtc_build_index(fname, index) != 0) {
+        free(index_fname);
+        return -1;
+    }
+
+    // Only saved if the file was not written to while the index was built, eg by a running simulation, 
+    // and does not end in an incomplete frame, which may yet be finished
+    if(file_stamp(fname, stamp) == 0 && stamp[0] == index->file_size 
+        && stamp[1] == index->mtime_sec && stamp[2] == index->mtime_nsec && index_complete(fname, index)) {
+        save_index(index_fname, index);
+    }
+    free(index_fname);
+    return 0;
+}
+
+
+void xtc_free_index(struct xtc_index *index) {
+    free(index->offsets);
+    free(index->steps);
+    free(index->times);
+    free(index->boxes);
+    memset(index, 0, sizeof(*index));
+}
+
+
+void xtc_decoder_init(struct xtc_decoder *dec) {
+    memset(dec, 0, sizeof(*dec));
+}
+
+
+void xtc_decoder_free(struct xtc_decoder *dec) {
+    free(dec->bytes);
+    free(dec->ints);
+    memset(dec, 0, sizeof(*dec));
+}
+
+
+int xtc_skip_frame(FILE *f, int *natoms, int *step, float *time, float box[3][3]) {
+    int n, lsize, large, ret;
+    float precision;
+    int minmax[6], smallidx;
+    int64_t nbytes;
+
+    ret = read_header(f, &n, step, time, box, &large);
+    if(ret <= 0)    return ret;
+    if(natoms)  *natoms = n;
+
+    if(read_int(f, &lsize) || lsize != n)   return -1;
+    if(n <= XTC_MAXSMALL) {
+        return fseeko(f, 3 * n * 4, SEEK_CUR) ? -1 : 1;
+    }
+
+    if(read_float(f, &precision))   return -1;
+    for(int i = 0; i < 6; ++i) {
+        if(read_int(f, &minmax[i]))     return -1;
+    }
+    if(read_int(f, &smallidx))  return -1;
+    if(large) {
+        if(read_int64(f, &nbytes))  return -1;
+    }
+    else {
+        int nb;
+        if(read_int(f, &nb))    return -1;
+        nbytes = nb;
+    }
+    if(nbytes < 0)  return -1;
+
+    // XDR pads the bytes to a multiple of 4
+    return fseeko(f, (nbytes + 3) / 4 * 4, SEEK_CUR) ? -1 : 1;
+}
+
+
+int xtc_read_frame(FILE *f, struct xtc_decoder *dec, int natoms, int *step, float *time, float box[3][3], float *x) {
+    int n, lsize, large, ret;
+    float precision;
+    int minint[3], maxint[3], smallidx;
+    unsigned int sizeint[3], sizesmall[3];
+    int bitsizeint[3], bitsize;
+    int64_t nbytes;
+
+    ret = read_header(f, &n, step, time, box, &large);
+    if(ret <= 0)    return ret;
+    if(n != natoms || read_int(f, &lsize) || lsize != n)    return -1;
+
+    if(n <= XTC_MAXSMALL) {
+        for(int i = 0; i < 3 * n; ++i) {
+            if(read_float(f, &x[i]))    return -1;
+        }
+        return 1;
+    }
+
+    if(read_float(f, &precision))   return -1;
+    for(int i = 0; i < 3; ++i) {
+        if(read_int(f, &minint[i]))     return -1;
+    }
+    for(int i = 0; i < 3; ++i) {
+        if(read_int(f, &maxint[i]))     return -1;
+    }
+    if(read_int(f, &smallidx) || smallidx < XTC_FIRSTIDX || smallidx >= XTC_LASTIDX)    return -1;
+    if(large) {
+        if(read_int64(f, &nbytes))  return -1;
+    }
+    else {
+        int nb;
+        if(read_int(f, &nb))    return -1;
+        nbytes = nb;
+    }
+    if(nbytes < 0)  return -1;
+
+    // Compressed bytes, padded to a multiple of 4
+    size_t padded = (nbytes + 3) / 4 * 4;
+    if(padded > dec->nbytes) {
+        free(dec->bytes);
+        dec->bytes = malloc(padded);
+        dec->nbytes = dec->bytes ? padded : 0;
+        if(dec->bytes == NULL)  return -1;
+    }
+    if(fread(dec->bytes, 1, padded, f) != padded)   return -1;
+
+    if(3 * n > dec->nints) {
+        free(dec->ints);
+        dec->ints = malloc(3 * n * sizeof(int));
+        dec->nints = dec->ints ? 3 * n : 0;
+        if(dec->ints == NULL)   return -1;
+    }
+
+    for(int i = 0; i < 3; ++i) {
+        sizeint[i] = maxint[i] - minint[i] + 1;
+    }
+    if((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff) { // too large to be packed together
+        for(int i = 0; i < 3; ++i) {
+            bitsizeint[i] = sizeofint(sizeint[i]);
+        }
+        bitsize = 0;
+    }
+    else {
+        bitsize = sizeofints(sizeint);
+    }
+
+    int smaller = magicints[XTC_FIRSTIDX > smallidx - 1 ? XTC_FIRSTIDX : smallidx - 1] / 2;
+    int smallnum = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+
+    struct bit_reader b = {dec->bytes, nbytes, 0, 0, 0};
+    float inv_precision = 1.0f / precision;
+    int *thiscoord, prevcoord[3];
+    int run = 0; // Length of the current run of small differences (3 per atom), kept until a new one is flagged
+    float *lfp = x;
+
+    for(int i = 0; i < n; ) {
+        thiscoord = &dec->ints[3 * i];
+        if(bitsize == 0) {
+            thiscoord[0] = decode_bits(&b, bitsizeint[0]);
+            thiscoord[1] = decode_bits(&b, bitsizeint[1]);
+            thiscoord[2] = decode_bits(&b, bitsizeint[2]);
+        }
+        else {
+            decode_ints(&b, bitsize, sizeint, thiscoord);
+        }
+        ++i;
+        for(int d = 0; d < 3; ++d) {
+            thiscoord[d] += minint[d];
+            prevcoord[d] = thiscoord[d];
+        }
+
+        int is_smaller = 0;
+        if(decode_bits(&b, 1)) {
+            run = decode_bits(&b, 5);
+            is_smaller = run % 3;
+            run -= is_smaller;
+            --is_smaller;
+        }
+
+        if(run > 0) {
+            if(i + run / 3 > n)     return -1;
+            thiscoord += 3;
+            for(int k = 0; k < run; k += 3) {
+                decode_ints(&b, smallidx, sizesmall, thiscoord);
+                ++i;
+                for(int d = 0; d < 3; ++d) {
+                    thiscoord[d] += prevcoord[d] - smallnum;
+                }
+                if(k == 0) { // the first two atoms of a run are swapped, for better compression of water
+                    for(int d = 0; d < 3; ++d) {
+                        int tmp = thiscoord[d];
+                        thiscoord[d] = prevcoord[d];
+                        prevcoord[d] = tmp;
+                    }
+                    for(int d = 0; d < 3; ++d) {
+                        *lfp++ = prevcoord[d] * inv_precision;
+                    }
+                }
+                else {
+                    for(int d = 0; d < 3; ++d) {
+                        prevcoord[d] = thiscoord[d];
+                    }
+                }
+                for(int d = 0; d < 3; ++d) {
+                    *lfp++ = thiscoord[d] * inv_precision;
+                }
+            }
+        }
+        else {
+            for(int d = 0; d < 3; ++d) {
+                *lfp++ = thiscoord[d] * inv_precision;
+            }
+        }
+
+        smallidx += is_smaller;
+        if(smallidx < XTC_FIRSTIDX || smallidx >= XTC_LASTIDX)  return -1;
+        if(is_smaller < 0) {
+            smallnum = smaller;
+            smaller = smallidx > XTC_FIRSTIDX ? magicints[smallidx - 1] / 2 : 0;
+        }
+        else if(is_smaller > 0) {
+            smaller = smallnum;
+            smallnum = magicints[smallidx] / 2;
+        }
+        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    }
+
+    return b.cnt <= b.nbytes ? 1 : -1;
+}
+
+
+static int file_stamp(const char *fname, int64_t stamp[3]) {
+    struct stat st;
+    if(stat(fname, &st) != 0)   return -1;
+    stamp[0] = st.st_size;
+    stamp[1] = st.st_mtim.tv_sec;
+    stamp[2] = st.st_mtim.tv_nsec;
+    return 0;
+}
+
+
+static int load_index(const char *index_fname, const int64_t stamp[3], struct xtc_index *index) {
+    FILE *f = fopen(index_fname, "rb");
+    char magic[8];
+    int64_t saved[3];
+    int32_t n[2];
+
+    memset(index, 0, sizeof(*index));
+    if(f == NULL)   return -1;
+
+    if(fread(magic, 1, 8, f) != 8 || memcmp(magic, "GTAXIDX", 8) != 0 
+        || fread(saved, sizeof(int64_t), 3, f) != 3 || memcmp(saved, stamp, sizeof(saved)) != 0 
+        || fread(n, sizeof(int32_t), 2, f) != 2 || n[0] <= 0 || n[1] < 0) {
+        fclose(f);
+        return -1;
+    }
+
+    int nframes = n[0];
+    index->offsets = malloc(nframes * sizeof(*index->offsets));
+    index->steps = malloc(nframes * sizeof(*index->steps));
+    index->times = malloc(nframes * sizeof(*index->times));
+    index->boxes = malloc(nframes * sizeof(*index->boxes));
+    index->nframes = nframes;
+    index->natoms = n[1];
+    index->file_size = stamp[0];
+    index->mtime_sec = stamp[1];
+    index->mtime_nsec = stamp[2];
+
+    int ok = index->offsets && index->steps && index->times && index->boxes 
+        && fread(index->offsets, sizeof(*index->offsets), nframes, f) == (size_t)nframes 
+        && fread(index->steps, sizeof(*index->steps), nframes, f) == (size_t)nframes 
+        && fread(index->times, sizeof(*index->times), nframes, f) == (size_t)nframes 
+        && fread(index->boxes, sizeof(*index->boxes), nframes, f) == (size_t)nframes;
+    fclose(f);
+
+    if(!ok) {
+        xtc_free_index(index);
+        return -1;
+    }
+    return 0;
+}
+
+
+static int save_index(const char *index_fname, const struct xtc_index *index) {
+    size_t len = strlen(index_fname);
+    char *tmp_fname = malloc(len + 5);
+    int64_t stamp[3] = {index->file_size, index->mtime_sec, index->mtime_nsec};
+    int32_t n[2] = {index->nframes, index->natoms};
+    int nframes = index->nframes;
+
+    if(tmp_fname == NULL)   return -1;
+    memcpy(tmp_fname, index_fname, len);
+    memcpy(tmp_fname + len, ".tmp", 5);
+
+    // Written to a temporary file first, so that a run reading the index never sees a partial one
+    FILE *f = fopen(tmp_fname, "wb");
+    if(f == NULL) {
+        free(tmp_fname);
+        return -1;
+    }
+    int ok = fwrite("GTAXIDX", 1, 8, f) == 8 
+        && fwrite(stamp, sizeof(int64_t), 3, f) == 3 
+        && fwrite(n, sizeof(int32_t), 2, f) == 2 
+        && fwrite(index->offsets, sizeof(*index->offsets), nframes, f) == (size_t)nframes 
+        && fwrite(index->steps, sizeof(*index->steps), nframes, f) == (size_t)nframes 
+        && fwrite(index->times, sizeof(*index->times), nframes, f) == (size_t)nframes 
+        && fwrite(index->boxes, sizeof(*index->boxes), nframes, f) == (size_t)nframes;
+    ok = fclose(f) == 0 && ok;
+
+    if(!ok || rename(tmp_fname, index_fname) != 0) {
+        remove(tmp_fname);
+        free(tmp_fname);
+        return -1;
+    }
+    free(tmp_fname);
+    return 0;
+}
+
+
+static int read_int(FILE *f, int *i) {
+    unsigned char c[4];
+    if(fread(c, 1, 4, f) != 4)  return -1;
+    *i = (int)(((uint32_t)c[0] << 24) | ((uint32_t)c[1] << 16) | ((uint32_t)c[2] << 8) | c[3]);
+    return 0;
+}
+
+
+static int read_int64(FILE *f, int64_t *i) {
+    int hi, lo;
+    if(read_int(f, &hi) || read_int(f, &lo))    return -1;
+    *i = (int64_t)(((uint64_t)(uint32_t)hi << 32) | (uint32_t)lo);
+    return 0;
+}
+
+
+static int read_float(FILE *f, float *x) {
+    int i;
+    if(read_int(f, &i))     return -1;
+    memcpy(x, &i, sizeof(*x));
+    return 0;
+}
+
+
+static int index_complete(const char *fname, const struct xtc_index *index) {
+    FILE *f = fopen(fname, "rb");
+    if(f == NULL)   return 0;
+
+    int ok = fseeko(f, index->offsets[index->nframes - 1], SEEK_SET) == 0 
+        && xtc_skip_frame(f, NULL, NULL, NULL, NULL) == 1 && ftello(f) == index->file_size;
+    fclose(f);
+    return ok;
+}
+
+
+static int read_header(FILE *f, int *natoms, int *step, float *time, float box[3][3], int *large) {
+    int magic, s;
+    float t, b[3][3];
+
+    if(read_int(f, &magic))     return 0; // end of the file
+    if(magic != XTC_MAGIC && magic != XTC_MAGIC_LARGE)  return -1;
+    if(read_int(f, natoms) || *natoms < 0 || read_int(f, &s) || read_float(f, &t))  return -1;
+    for(int i = 0; i < 3; ++i) {
+        for(int j = 0; j < 3; ++j) {
+            if(read_float(f, &b[i][j]))     return -1;
+        }
+    }
+
+    if(step)    *step = s;
+    if(time)    *time = t;
+    if(box)     memcpy(box, b, sizeof(b));
+    *large = magic == XTC_MAGIC_LARGE;
+    return 1;
+}
+
+
+static int decode_bits(struct bit_reader *b, int nbits) {
+    unsigned int lastbits = b->lastbits, lastbyte = b->lastbyte;
+    int mask = nbits < 32 ? (1 << nbits) - 1 : -1;
+    int num = 0;
+
+    // Past the end of the bytes, zeros are read and the error is caught by the caller from b->cnt
+    while(nbits >= 8) {
+        lastbyte = (lastbyte << 8) | (b->cnt < b->nbytes ? b->bytes[b->cnt] : 0);
+        ++b->cnt;
+        num |= (lastbyte >> lastbits) << (nbits - 8);
+        nbits -= 8;
+    }
+    if(nbits > 0) {
+        if(lastbits < (unsigned int)nbits) {
+            lastbits += 8;
+            lastbyte = (lastbyte << 8) | (b->cnt < b->nbytes ? b->bytes[b->cnt] : 0);
+            ++b->cnt;
+        }
+        lastbits -= nbits;
+        num |= (lastbyte >> lastbits) & ((1 << nbits) - 1);
+    }
+
+    b->lastbits = lastbits;
+    b->lastbyte = lastbyte;
+    return num & mask;
+}
+
+
+static void decode_ints(struct bit_reader *b, int nbits, const unsigned int sizes[3], int nums[3]) {
+    int bytes[32];
+    int nbytes = 0;
+
+    bytes[1] = bytes[2] = bytes[3] = 0;
+    while(nbits > 8) {
+        bytes[nbytes++] = decode_bits(b, 8);
+        nbits -= 8;
+    }
+    if(nbits > 0) {
+        bytes[nbytes++] = decode_bits(b, nbits);
+    }
+
+    // Divide the packed number by the sizes, from the last integer to the second
+    for(int i = 2; i > 0; --i) {
+        unsigned int num = 0;
+        for(int j = nbytes - 1; j >= 0; --j) {
+            num = (num << 8) | bytes[j];
+            unsigned int p = num / sizes[i];
+            bytes[j] = p;
+            num -= p * sizes[i];
+        }
+        nums[i] = num;
+    }
+    nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+}
+
+
+static int sizeofint(int size) {
+    unsigned int num = 1;
+    int nbits = 0;
+
+    while((unsigned int)size >= num && nbits < 32) {
+        ++nbits;
+        num <<= 1;
+    }
+    return nbits;
+}
+
+
+static int sizeofints(const unsigned int sizes[3]) {
+    unsigned int bytes[32], nbytes = 1, nbits = 0, num = 1;
+
+    bytes[0] = 1;
+    for(int i = 0; i < 3; ++i) {
+        unsigned int tmp = 0, cnt;
+        for(cnt = 0; cnt < nbytes; ++cnt) {
+            tmp = bytes[cnt] * sizes[i] + tmp;
+            bytes[cnt] = tmp & 0xff;
+            tmp >>= 8;
+        }
+        while(tmp != 0) {
+            bytes[cnt++] = tmp & 0xff;
+            tmp >>= 8;
+        }
+        nbytes = cnt;
+    }
+
+    --nbytes;
+    while(bytes[nbytes] >= num) {
+        ++nbits;
+        num *= 2;
+    }
+    return nbits + nbytes * 8;
+}